@@ -0,0 +1,252 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObjectPtr.h"
+
+#include <angelscript.h>
+#include <atomic>
+#include <cstdint> // uint64_t
+#include <cstdlib> // std::abort
+#include <new> // placement new
+#include <stdio.h> // snprintf
+
+/// Smart pointer which can be read and written by multiple threads at once (i.e. a global shared by script contexts),
+/// like `std::atomic<std::shared_ptr<>>`. Lock-free; the pointed-to type should use `RefCountingObjectMultiThreaded`.
+///
+/// Uses a split refcount: the pointer and a 'local' count of readers which are just taking a reference
+/// are packed into a single 64-bit word. A reader first borrows the slot's own reference (increments local count),
+/// then does `AddRef()` and returns the borrow. A writer which replaces the pointer converts all outstanding borrows
+/// into real references before releasing the slot's reference, so the object can't die under a reader.
+///
+/// Limits: object addresses must fit in 48 bits (checked on every store, also in release builds - fails i.e. with
+/// 5-level paging or tagged pointers), and at most 65535 threads may be inside `load()` of one pointer at the same time
+/// (the local count is 16 bits; only asserted).
+template<class T>
+class AtomicRefCountingObjectPtr
+{
+public:
+    AtomicRefCountingObjectPtr(): m_packed(0) {}
+    AtomicRefCountingObjectPtr(RefCountingObjectPtr<T> desired): m_packed(Pack(desired.Detach())) {}
+    ~AtomicRefCountingObjectPtr();
+
+    AtomicRefCountingObjectPtr(const AtomicRefCountingObjectPtr&) = delete;
+    AtomicRefCountingObjectPtr& operator=(const AtomicRefCountingObjectPtr&) = delete;
+
+    RefCountingObjectPtr<T> load() const;
+    void store(RefCountingObjectPtr<T> desired) { this->exchange(std::move(desired)); }
+    RefCountingObjectPtr<T> exchange(RefCountingObjectPtr<T> desired);
+    /// If the current pointer equals `expected`, replaces it with `desired`. Otherwise loads the current one into `expected`.
+    bool compare_exchange(RefCountingObjectPtr<T> &expected, RefCountingObjectPtr<T> desired);
+
+    // Compare pointer - no reference is taken.
+    bool operator==(const T* o) const { return Unpack(m_packed.load(std::memory_order_acquire)) == o; }
+    bool operator!=(const T* o) const { return Unpack(m_packed.load(std::memory_order_acquire)) != o; }
+
+    void EnumReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine *engine);
+    void ReleaseReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine *engine);
+
+    static void RegisterAtomicRefCountingObjectPtr(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* handle_name, const char* obj_name);
+
+protected:
+    static const int LOCAL_BITS = 16; //!< Pointers must fit in the remaining 48 bits.
+    static const uint64_t LOCAL_MASK = (uint64_t(1) << LOCAL_BITS) - 1;
+
+    static uint64_t Pack(T* ref);
+    static T* Unpack(uint64_t packed) { return reinterpret_cast<T*>(static_cast<uintptr_t>(packed >> LOCAL_BITS)); }
+    /// Turns borrows of a replaced pointer into references; returns the pointer with the slot's reference.
+    static T* TransferBorrows(uint64_t replaced);
+
+    // Wrapper functions, to be invoked by AngelScript only!
+    static void ConstructDefault(AtomicRefCountingObjectPtr<T> *self) { new(self) AtomicRefCountingObjectPtr(); }
+    static void ConstructRef(AtomicRefCountingObjectPtr<T>* self, void** objhandle) { new(self) AtomicRefCountingObjectPtr(RefCountingObjectPtr<T>(static_cast<T*>(*objhandle))); }
+    static void Destruct(AtomicRefCountingObjectPtr<T> *self) { self->~AtomicRefCountingObjectPtr(); }
+
+    // Script methods are members, registered as THISCALL - see `RefCountingObjectPtr`.
+    T* OpImplCast() const { return this->load().Detach(); }
+    void OpAssign(void** objhandle) { this->store(RefCountingObjectPtr<T>(static_cast<T*>(*objhandle))); }
+    T* Exchange(void** objhandle) { return this->exchange(RefCountingObjectPtr<T>(static_cast<T*>(*objhandle))).Detach(); }
+    bool OpEquals(void** objhandle) const { return *this == static_cast<T*>(*objhandle); }
+
+    mutable std::atomic<uint64_t> m_packed; //!< Pointer << LOCAL_BITS | local count
+};
+
+template<class T>
+void AtomicRefCountingObjectPtr<T>::RegisterAtomicRefCountingObjectPtr(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* handle_name, const char* obj_name)
+{
+    int r;
+    const size_t DECLBUF_MAX = 300;
+    char decl_buf[DECLBUF_MAX];
+
+#if defined(AS_USE_NAMESPACE)
+    using namespace AngelScript;
+#endif
+
+    const bool gc = !RefCountingObjectTraits<T>::acyclic;
+
+    // Not copyable - like `std::atomic<>`, for globals and members only.
+    r = engine->RegisterObjectType(handle_name, sizeof(AtomicRefCountingObjectPtr), asOBJ_VALUE | asOBJ_ASHANDLE | (gc ? asOBJ_GC : 0) | asGetTypeTraits<AtomicRefCountingObjectPtr>()); RefCountingObjectPtr_ASSERT( r >= 0 );
+
+    // construct/destruct
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(AtomicRefCountingObjectPtr::ConstructDefault), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "void f(%s @&in)", obj_name);
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, decl_buf, asFUNCTION(AtomicRefCountingObjectPtr::ConstructRef), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_DESTRUCT, "void f()", asFUNCTION(AtomicRefCountingObjectPtr::Destruct), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+
+    // GC
+    if (gc)
+    {
+        r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_ENUMREFS, "void f(int&in)", asMETHOD(AtomicRefCountingObjectPtr, EnumReferences), asCALL_THISCALL); RefCountingObjectPtr_ASSERT(r >= 0);
+        r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_RELEASEREFS, "void f(int&in)", asMETHOD(AtomicRefCountingObjectPtr, ReleaseReferences), asCALL_THISCALL); RefCountingObjectPtr_ASSERT(r >= 0);
+    }
+
+    // Load
+    snprintf(decl_buf, DECLBUF_MAX, "%s @ opImplCast()", obj_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHOD(AtomicRefCountingObjectPtr, OpImplCast), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "%s @ GetHandle()", obj_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHOD(AtomicRefCountingObjectPtr, OpImplCast), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+
+    // Store
+    snprintf(decl_buf, DECLBUF_MAX, "void opHndlAssign(const %s @&in)", obj_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHOD(AtomicRefCountingObjectPtr, OpAssign), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "%s @ Exchange(const %s @&in)", obj_name, obj_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHOD(AtomicRefCountingObjectPtr, Exchange), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+
+    // Equals
+    snprintf(decl_buf, DECLBUF_MAX, "bool opEquals(const %s @&in) const", obj_name);
+    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHOD(AtomicRefCountingObjectPtr, OpEquals), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+}
+
+// ---------------------------- Internals ------------------------------
+
+template<class T>
+inline AtomicRefCountingObjectPtr<T>::~AtomicRefCountingObjectPtr()
+{
+    const uint64_t packed = m_packed.load(std::memory_order_acquire);
+    RefCountingObjectPtr_ASSERT((packed & LOCAL_MASK) == 0); // Nobody may be reading anymore.
+    T* ref = Unpack(packed);
+    if (ref)
+        ref->Release();
+}
+
+template<class T>
+inline uint64_t AtomicRefCountingObjectPtr<T>::Pack(T* ref)
+{
+    static_assert(sizeof(uintptr_t) <= sizeof(uint64_t), "AtomicRefCountingObjectPtr: pointers must fit in 64 bits");
+    const uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(ref));
+    if ((bits >> (64 - LOCAL_BITS)) != 0)
+    {
+        RefCountingObjectPtr_ASSERT(!"AtomicRefCountingObjectPtr: address wider than 48 bits");
+        std::abort(); // The high bits would be lost - the object would later be accessed through a wild pointer.
+    }
+    return bits << LOCAL_BITS;
+}
+
+template<class T>
+inline T* AtomicRefCountingObjectPtr<T>::TransferBorrows(uint64_t replaced)
+{
+    T* ref = Unpack(replaced);
+    const int borrows = static_cast<int>(replaced & LOCAL_MASK);
+    if (ref && borrows > 0)
+        ref->AddRef(borrows);
+    return ref;
+}
+
+template<class T>
+inline RefCountingObjectPtr<T> AtomicRefCountingObjectPtr<T>::load() const
+{
+    // Borrow the slot's reference - the pointer can't die until we return it.
+    const uint64_t borrowed = m_packed.fetch_add(1, std::memory_order_acq_rel);
+    RefCountingObjectPtr_ASSERT((borrowed & LOCAL_MASK) != LOCAL_MASK); // Too many concurrent readers.
+    T* ref = Unpack(borrowed);
+    if (ref)
+        ref->AddRef();
+
+    // Return the borrow, unless a writer replaced the pointer meanwhile and turned it into a reference.
+    // If the same pointer was stored again (ABA), we may return somebody else's borrow instead - it's the same object, counts still add up.
+    uint64_t current = m_packed.load(std::memory_order_relaxed);
+    while (Unpack(current) == ref && (current & LOCAL_MASK) != 0)
+    {
+        if (m_packed.compare_exchange_weak(current, current - 1, std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            RefCountingObjectPtr<T> result;
+            result.Adopt(ref);
+            return result;
+        }
+    }
+
+    if (ref)
+        ref->Release(); // The writer's reference stays ours.
+    RefCountingObjectPtr<T> result;
+    result.Adopt(ref);
+    return result;
+}
+
+template<class T>
+inline RefCountingObjectPtr<T> AtomicRefCountingObjectPtr<T>::exchange(RefCountingObjectPtr<T> desired)
+{
+    const uint64_t replaced = m_packed.exchange(Pack(desired.Detach()), std::memory_order_acq_rel);
+    RefCountingObjectPtr<T> result;
+    result.Adopt(TransferBorrows(replaced));
+    return result;
+}
+
+template<class T>
+inline bool AtomicRefCountingObjectPtr<T>::compare_exchange(RefCountingObjectPtr<T> &expected, RefCountingObjectPtr<T> desired)
+{
+    uint64_t current = m_packed.load(std::memory_order_relaxed);
+    while (Unpack(current) == expected.GetRef())
+    {
+        if (m_packed.compare_exchange_weak(current, Pack(desired.GetRef()), std::memory_order_acq_rel, std::memory_order_relaxed))
+        {
+            desired.Detach(); // The slot's reference now.
+            RefCountingObjectPtr<T> replaced;
+            replaced.Adopt(TransferBorrows(current));
+            return true;
+        }
+    }
+
+    expected = this->load();
+    return false;
+}
+
+template<class T>
+inline void AtomicRefCountingObjectPtr<T>::EnumReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine *inEngine)
+{
+    T* ref = Unpack(m_packed.load(std::memory_order_acquire));
+    if (ref)
+        inEngine->GCEnumCallback(ref);
+}
+
+template<class T>
+inline void AtomicRefCountingObjectPtr<T>::ReleaseReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine * /*inEngine*/)
+{
+    this->store(RefCountingObjectPtr<T>());
+}
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
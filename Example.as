@@ -28,6 +28,9 @@ void CustomizedPtrTest()
     Print("# create and test anonymous native handle using GetHandle() method\n");
     ref1.GetHandle().Neigh();
     
+    Print("# same via Borrow() - a reference to the stored handle, without the extra AddRef/Release\n");
+    ref1.Borrow().Neigh();
+    
     Print("# adding ref using customized handle\n");
     HorsePtr@ ref2 = ref1;
     
@@ -35,6 +38,13 @@ void CustomizedPtrTest()
     Print("`(ref2 == ref1)`: " + (ref2 == ref1) + "\n");
     Print("`(@ref2 == @ref1)`: " + (@ref2 == @ref1) + "\n");
     
+    Print("# Test ordering and hashing of customized handles (by address)\n");
+    HorsePtr@ other = Horse();
+    Check(ref1.opCmp(ref2) == 0 && ref1.GetHash() == ref2.GetHash(), "handles to the same horse are equivalent");
+    Check(ref1.opCmp(other) != 0 && ref1.opCmp(other) == -other.opCmp(ref1), "handles to different horses are ordered");
+    Check((ref1 < other) != (other < ref1), "opCmp() via operators");
+    @other = null;
+    
     Print("# create null customized handle\n");
     HorsePtr@ ref3 = null;
     
@@ -105,9 +115,16 @@ void AppInterfaceNativePtrTest()
 
     Print("# fetching horse back from stable\n");
     @ho = FetchFromStable();
+
+    Print("# checking horse is in stable via borrowed handle (no refcounting)\n");
+    Print("`IsInStable(ho)`: " + IsInStable(ho) + "\n");
+    Check(IsInStable(ho), "IsInStable() of the fetched horse");
+    Check(!IsInStable(Horse()), "IsInStable() of another horse");
+    Check(!IsInStable(null), "IsInStable(null)");
     
     Print("# Dump horse from stable\n");
     PutToStable(null);
+    Check(!IsInStable(ho), "IsInStable() after the stable was emptied");
     
     Print("# Erase local horse ref\n");
     @ho = null;    
@@ -147,6 +164,109 @@ void AppInterfaceCustomizedPtrTest()
     // ho
 }
 
+void PtrArrayTest()
+{
+    Print("# creating array of customized handles\n");
+    HorsePtrArray@ arr = HorsePtrArray();
+    Horse@ ho = Horse(); // "Bucephalus"
+
+    Print("# adding the same horse 3 times, and one unreferenced horse\n");
+    arr.insertLast(ho);
+    arr.insertLast(ho);
+    arr.insertLast(ho);
+    arr.insertLast(Horse()); // "Binky"
+    Print("`arr.length()`: " + arr.length() + "\n");
+    Print("`arr.findByRef(ho)`: " + arr.findByRef(ho) + "\n");
+    Check(arr.length() == 4, "array length after 4 inserts");
+    Check(arr.findByRef(ho) == 0, "findByRef() finds the first copy");
+    Check(arr[1] == ho && arr[2] == ho && !(arr[3] == ho), "array elements");
+
+    Print("# use element via GetHandle()\n");
+    arr[3].GetHandle().Neigh();
+
+    Print("# doubling the array - one AddRef() per horse\n");
+    arr.insertLast(arr);
+    Check(arr.length() == 8, "array length after appending itself");
+    Check(arr[4] == ho && arr[7] == arr[3], "appended elements");
+
+    Print("# removing 6 elements at once - one Release() per horse\n");
+    arr.removeRange(0, 6);
+    Check(arr.length() == 2, "array length after removeRange()");
+    Check(arr[0] == ho && arr.findByRef(ho) == 0, "elements after removeRange()");
+
+    Print("# Erase local horse ref\n");
+    @ho = null;
+
+    Print("# array goes out of scope - the garbage collector will delete it with the horses\n");
+    // arr
+}
+
+void PtrMapTest()
+{
+    Print("# riding a horse twice, and a null horse once\n");
+    Horse@ ho = Horse(); // "Tornado"
+    RideHorse(ho);
+    RideHorse(ho);
+    RideHorse(null);
+    Check(CountRides(ho) == 2, "rides of the ridden horse");
+    Check(CountRides(Horse()) == 0, "rides of another horse");
+    Check(CountRides(null) == 0 && CountRiddenHorses() == 1, "null horse isn't in the map");
+    
+    Print("# Erase local horse ref - the map keeps the horse alive\n");
+    @ho = null;
+    Check(CountRiddenHorses() == 1, "the map owns its keys");
+    
+    Print("# forget the rides - the horse will be deleted\n");
+    ForgetRides();
+    Check(CountRiddenHorses() == 0, "map is empty after ForgetRides()");
+}
+
+void WeakRefTest()
+{
+    Print("# creating horse, watching it via weak reference\n");
+    Horse@ ho = Horse(); // "Pegasus"
+    WatchHorse(ho);
+    Check(GetWatchedHorse() == ho, "weak reference to a live horse");
+    
+    Print("# Erase horse ref - the weak reference doesn't keep the horse alive\n");
+    @ho = null;
+    Check(GetWatchedHorse().GetHandle() is null, "weak reference to a dead horse");
+}
+
+void DeferredReleaseTest()
+{
+    Print("# creating cow with deferred destruction\n");
+    Cow@ cow = Cow(); // "Rosa"
+    cow.Moo();
+    
+    Print("# Erase cow ref - the cow is queued, not deleted\n");
+    @cow = null;
+    Check(GetReleaseQueueDepth() == 1, "the released cow is queued");
+    
+    Print("# drain the release queue - the cow will be deleted\n");
+    Check(DrainReleaseQueue() == 1, "DrainReleaseQueue() destroys the queued cow");
+    Check(GetReleaseQueueDepth() == 0, "release queue is empty after draining");
+}
+
+void ArenaTest()
+{
+    Print("# spawning 2 flies in the frame arena\n");
+    Fly@ fly = SpawnFly();
+    FlyPtr@ ptr = SpawnFly();
+    fly.Buzz();
+    ptr.GetHandle().Buzz();
+    Check(CountFlies() == 2, "flies live in the arena");
+    Check(!(ptr == fly), "distinct flies");
+    
+    Print("# Erase fly refs - nothing happens, the arena owns the flies\n");
+    @fly = null;
+    @ptr = null;
+    
+    Print("# end the frame - all flies are deleted at once\n");
+    EndFrame();
+    Check(CountFlies() == 0, "arena is empty after EndFrame()");
+}
+
 void ExampleAngelScript()
 {
     Print("##  BEGIN native handle test\n");
@@ -165,6 +285,26 @@ void ExampleAngelScript()
     AppInterfaceCustomizedPtrTest();
     Print("##  END app interface + Customized handle test\n");
     
+    Print("##  BEGIN handle array test\n");
+    PtrArrayTest();
+    Print("##  END handle array test\n");
+    
+    Print("##  BEGIN map test\n");
+    PtrMapTest();
+    Print("##  END map test\n");
+    
+    Print("##  BEGIN weak reference test\n");
+    WeakRefTest();
+    Print("##  END weak reference test\n");
+    
+    Print("##  BEGIN deferred release test\n");
+    DeferredReleaseTest();
+    Print("##  END deferred release test\n");
+    
+    Print("##  BEGIN arena test\n");
+    ArenaTest();
+    Print("##  END arena test\n");
+    
      
     Print("# Create parrot\n");
     Parrot@ parr = Parrot();
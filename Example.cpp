@@ -1,6 +1,13 @@
 
 #include "RefCountingObject.h"
 #include "RefCountingObjectPtr.h"
+#include "RefCountingObjectRef.h"
+#include "RefCountingObjectPtrArray.h"
+#include "RefCountingObjectPtrMap.h"
+#include "RefCountingObjectRegistration.h"
+#include "RefCountingObjectReleaseQueue.h"
+#include "RefCountingObjectWeakPtr.h"
+#include "RefCountingObjectArena.h"
 
 #include <string>
 #include <vector>
@@ -14,29 +21,72 @@ public:
     void Neigh() { std::cout << COLOR_THEME_OBJ << this << ": neigh!"<< COLOR_RESET <<  std::endl; }
 };
 
-class Parrot: public RefCountingObject<Parrot>
+class Parrot;
+template<> struct RefCountingObjectTraits<Parrot>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false; // Parrot is a leaf type - no vtable needed.
+    static constexpr bool acyclic = true; // Parrot holds no references - `ParrotPtr` needn't involve the GC.
+    static constexpr char name[] = "Parrot"; // Script names, for `RegisterRefCountingObjectTypes<>()`
+    static constexpr char ptr_name[] = "ParrotPtr";
+};
+constexpr char RefCountingObjectTraits<Parrot>::name[];
+constexpr char RefCountingObjectTraits<Parrot>::ptr_name[];
+
+class Parrot final: public RefCountingObject<Parrot>
 {
 public:
     void Chirp() { std::cout << COLOR_THEME_OBJ << this <<": chirp!"<< COLOR_RESET << std::endl; }
 };
 
+// Deferred destruction - a released cow waits in `RefCountingObjectReleaseQueue` until drained.
+class Cow: public RefCountingObjectDeferred<Cow>
+{
+public:
+    void Moo() { std::cout << COLOR_THEME_OBJ << this <<": moo!"<< COLOR_RESET << std::endl; }
+};
+
+class Fly;
+template<> struct RefCountingObjectTraits<Fly>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool acyclic = true; // Fly holds no references - `FlyPtr` needn't involve the GC.
+};
+
+// Arena-owned - no refcounting, all flies die when the frame arena is reset.
+class Fly final: public RefCountingObjectArenaObject<Fly>
+{
+public:
+    void Buzz() { std::cout << COLOR_THEME_OBJ << this <<": bzzz!"<< COLOR_RESET << std::endl; }
+};
+
 typedef RefCountingObjectPtr<Horse> HorsePtr;
 typedef RefCountingObjectPtr<Parrot> ParrotPtr;
+typedef RefCountingObjectRef<Horse> HorseRef;
+typedef RefCountingObjectPtrArray<Horse> HorsePtrArray;
+typedef RefCountingObjectPtrMap<Horse, int> HorseRideMap;
+typedef RefCountingObjectPtr<Cow> CowPtr;
+typedef RefCountingObjectWeakPtr<Horse> HorseWeakPtr;
+typedef RefCountingObjectPtr<Fly> FlyPtr;
+
+// Implemented in main.cpp, counts failed checks (also registered to script as `Check()`)
+void ScriptCheck(bool ok, const std::string &what);
 
 Horse* HorseFactory()
 {
-    Horse* obj = new Horse();
+    Horse* obj = Horse::Create();
     obj->AddRef(); // This function is registered as "Horse@ f()" so we must manually increase refcount.
     return obj;
 }
 
 Parrot* ParrotFactory()
 {
-    return new Parrot(); // This function is registered as "Parrot@+ f()" (auto handle) so AngelScript will increase the refcount itself.
+    return Parrot::Create(); // This function is registered as "Parrot@+ f()" (auto handle) so AngelScript will increase the refcount itself.
 }
 
 static HorsePtr g_stable;
 static ParrotPtr g_aviary;
+static HorseWeakPtr g_watched; // Doesn't keep the horse alive
+static RefCountingObjectArena g_frame_arena;
+static HorseRideMap g_rides; // Keeps the ridden horses alive
 
 void PutToStable(HorsePtr horse)
 {
@@ -51,6 +101,44 @@ void PutToStable(HorsePtr horse)
     g_stable = horse;
 }
 
+bool IsInStable(HorseRef horse)
+{
+    // Borrowed reference - no refcounting when called from script.
+    return horse != nullptr && horse == g_stable;
+}
+
+void WatchHorse(HorsePtr horse)
+{
+    g_watched = horse;
+}
+
+HorsePtr GetWatchedHorse()
+{
+    return g_watched.Lock(); // Null if the horse is dead.
+}
+
+void RideHorse(HorsePtr horse)
+{
+    g_rides[horse]++; // Null horse is ignored
+}
+
+int CountRides(HorseRef horse)
+{
+    // Lookup by raw pointer - no refcounting.
+    const int* rides = g_rides.Find(horse.GetRef());
+    return (rides) ? *rides : 0;
+}
+
+asUINT CountRiddenHorses()
+{
+    return (asUINT)g_rides.Size();
+}
+
+void ForgetRides()
+{
+    g_rides.Clear();
+}
+
 HorsePtr FetchFromStable()
 {
     std::cout << COLOR_THEME_CPP << __FUNCTION__ << " called" << COLOR_RESET << std::endl;
@@ -78,6 +166,38 @@ ParrotPtr FetchFromAviary()
     return g_aviary;
 }
 
+Cow* CowFactory()
+{
+    return Cow::Create(); // Registered with 'auto handle' syntax, like the parrot factory.
+}
+
+asUINT GetReleaseQueueDepth()
+{
+    return (asUINT)RefCountingObjectReleaseQueue::Get().GetStats().depth;
+}
+
+asUINT DrainReleaseQueue()
+{
+    // A safe point - no script is using the queued objects anymore.
+    return (asUINT)RefCountingObjectReleaseQueue::Get().Drain();
+}
+
+Fly* SpawnFly()
+{
+    return Fly::Create(g_frame_arena); // Registered as "Fly@ f()" - no refcount, so no AddRef() either.
+}
+
+asUINT CountFlies()
+{
+    return (asUINT)g_frame_arena.GetStats().objects;
+}
+
+void EndFrame()
+{
+    // All flies die at once - no handles to them may remain.
+    g_frame_arena.Reset();
+}
+
 HorsePtr ExampleCppFunctionCall(HorsePtr argPtr)
 {
     std::cout << COLOR_THEME_CPP << __FUNCTION__ << " returning" << COLOR_RESET << std::endl;
@@ -103,19 +223,49 @@ void ExampleCpp(asIScriptEngine *engine)
     // Registering example interface
     r = engine->RegisterGlobalFunction("void PutToStable(HorsePtr@ h)", asFUNCTION(PutToStable), asCALL_CDECL); assert( r >= 0 );
     r = engine->RegisterGlobalFunction("HorsePtr@ FetchFromStable()", asFUNCTION(FetchFromStable), asCALL_CDECL); assert( r >= 0 );
+    // Register borrowed handle type, and a function which uses it
+    HorseRef::RegisterRefCountingObjectRef(engine, "HorseRef", "Horse", "HorsePtr");
+    r = engine->RegisterGlobalFunction("bool IsInStable(HorseRef@ h)", asFUNCTION(IsInStable), asCALL_CDECL); assert( r >= 0 );
+    // Registering weak reference interface
+    r = engine->RegisterGlobalFunction("void WatchHorse(HorsePtr@ h)", asFUNCTION(WatchHorse), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("HorsePtr@ GetWatchedHorse()", asFUNCTION(GetWatchedHorse), asCALL_CDECL); assert( r >= 0 );
+    // Registering map interface
+    r = engine->RegisterGlobalFunction("void RideHorse(HorsePtr@ h)", asFUNCTION(RideHorse), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("int CountRides(HorseRef@ h)", asFUNCTION(CountRides), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("uint CountRiddenHorses()", asFUNCTION(CountRiddenHorses), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void ForgetRides()", asFUNCTION(ForgetRides), asCALL_CDECL); assert( r >= 0 );
+    // Register array of handles
+    HorsePtrArray::RegisterRefCountingObjectPtrArray(engine, "HorsePtrArray", "Horse", "HorsePtr");
 
     // -- Parrot --
-    // Registering the reference type
-    Parrot::RegisterRefCountingObject(engine, "Parrot");
+    // Registering the reference type and handle type (names from `RefCountingObjectTraits<Parrot>`)
+    RegisterRefCountingObjectTypes<Parrot>(engine);
     r = engine->RegisterObjectMethod("Parrot", "void Chirp()", asMETHOD(Parrot, Chirp), asCALL_THISCALL); assert( r >= 0 );
     // Registering the factory behaviour (using 'auto handle' syntax)
     r = engine->RegisterObjectBehaviour("Parrot", asBEHAVE_FACTORY, "Parrot@+ f()", asFUNCTION(ParrotFactory), asCALL_CDECL); assert( r >= 0 );
-    // Register handle type
-    ParrotPtr::RegisterRefCountingObjectPtr(engine, "ParrotPtr", "Parrot");
     // Registering example interface
     r = engine->RegisterGlobalFunction("void PutToAviary(ParrotPtr@ h)", asFUNCTION(PutToAviary), asCALL_CDECL); assert( r >= 0 );
     r = engine->RegisterGlobalFunction("ParrotPtr@ FetchFromAviary()", asFUNCTION(FetchFromAviary), asCALL_CDECL); assert( r >= 0 );
 
+    // -- Cow --
+    // Registering the reference type and the factory (deferred destruction needs nothing special)
+    Cow::RegisterRefCountingObject(engine, "Cow");
+    r = engine->RegisterObjectMethod("Cow", "void Moo()", asMETHOD(Cow, Moo), asCALL_THISCALL); assert( r >= 0 );
+    r = engine->RegisterObjectBehaviour("Cow", asBEHAVE_FACTORY, "Cow@+ f()", asFUNCTION(CowFactory), asCALL_CDECL); assert( r >= 0 );
+    // Registering the release queue interface
+    r = engine->RegisterGlobalFunction("uint GetReleaseQueueDepth()", asFUNCTION(GetReleaseQueueDepth), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("uint DrainReleaseQueue()", asFUNCTION(DrainReleaseQueue), asCALL_CDECL); assert( r >= 0 );
+
+    // -- Fly --
+    // Registering the NOCOUNT reference type and handle type
+    Fly::RegisterRefCountingObject(engine, "Fly");
+    r = engine->RegisterObjectMethod("Fly", "void Buzz()", asMETHOD(Fly, Buzz), asCALL_THISCALL); assert( r >= 0 );
+    FlyPtr::RegisterRefCountingObjectPtr(engine, "FlyPtr", "Fly");
+    // Registering the arena interface (flies are spawned into the arena rather than by a factory)
+    r = engine->RegisterGlobalFunction("Fly@ SpawnFly()", asFUNCTION(SpawnFly), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("uint CountFlies()", asFUNCTION(CountFlies), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void EndFrame()", asFUNCTION(EndFrame), asCALL_CDECL); assert( r >= 0 );
+
     // Test horse interface from C++
     std::vector<HorsePtr> horses;
 
@@ -143,5 +293,50 @@ void ExampleCpp(asIScriptEngine *engine)
     ptr2 = new Horse(); // "Gunpowder"
     PrintString("ExampleCpp(): release ref\n");
     ptr2 = nullptr;
+
+    // Test map keyed by horses from C++
+    PrintString("ExampleCpp(): create horse, insert to map - the map adds ref\n");
+    HorseRideMap rides;
+    HorsePtr ptr4 = new Horse(); // "Epona"
+    ScriptCheck(rides.Insert(ptr4, 1) && !rides.Insert(ptr4, 2) && *rides.Find(ptr4.GetRef()) == 1, "C++: Insert() keeps the first value");
+    ScriptCheck(!rides.Insert(nullptr, 1) && !rides.Contains(nullptr) && rides.Size() == 1, "C++: null key isn't inserted");
+    rides[nullptr] = 5;
+    ScriptCheck(!rides.Contains(nullptr) && rides.Size() == 1, "C++: null key is ignored by operator[]");
+    PrintString("ExampleCpp(): erase horse from map, release ref - horse will be deleted\n");
+    ScriptCheck(rides.Erase(ptr4.GetRef()) && rides.Empty(), "C++: Erase() removes the horse");
+    ptr4 = nullptr;
+
+    // Test weak references from C++
+    PrintString("ExampleCpp(): create horse, make weak reference\n");
+    HorsePtr ptr3 = new Horse(); // "Sleipnir"
+    HorseWeakPtr weak = ptr3;
+    ScriptCheck(weak.Lock() == ptr3, "C++: Lock() of a live horse");
+    // The add-on's `weakref<Horse>` gets the flag from the engine, via the registered behaviour.
+    ScriptCheck(engine->GetWeakRefFlagOfScriptObject(ptr3.GetRef(), engine->GetTypeInfoByName("Horse")) == ptr3->GetWeakRefFlag(),
+        "C++: weakref<> sees the same weak ref flag");
+    PrintString("ExampleCpp(): release ref, horse will be deleted\n");
+    ptr3 = nullptr;
+    ScriptCheck(weak.Expired() && weak.Lock() == nullptr, "C++: Lock() of a dead horse");
+
+    // Test deferred destruction from C++
+    PrintString("ExampleCpp(): create cow, release it - it will be queued\n");
+    CowPtr cow = new Cow(); // "Milka"
+    cow = nullptr;
+    ScriptCheck(GetReleaseQueueDepth() == 1, "C++: the released cow is queued");
+    PrintString("ExampleCpp(): drain release queue, cow will be deleted\n");
+    ScriptCheck(DrainReleaseQueue() == 1 && GetReleaseQueueDepth() == 0, "C++: Drain() destroys the queued cow");
+
+    // Test arena objects from C++
+    PrintString("ExampleCpp(): spawn 2 flies in the frame arena\n");
+    FlyPtr fly1 = SpawnFly();
+    FlyPtr fly2 = SpawnFly();
+    ScriptCheck(CountFlies() == 2 && fly1 != fly2, "C++: flies live in the arena");
+    PrintString("ExampleCpp(): release flies, end frame - flies will be deleted\n");
+    fly1 = nullptr;
+    fly2 = nullptr;
+    const unsigned generation = g_frame_arena.GetGeneration();
+    EndFrame();
+    ScriptCheck(CountFlies() == 0 && g_frame_arena.GetGeneration() == generation + 1, "C++: EndFrame() resets the arena");
+
     PrintString("ExampleCpp(): 1 ref goes out of scope, object will be deleted\n");
 }
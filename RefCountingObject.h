@@ -7,44 +7,267 @@
 #pragma once
 
 #include <angelscript.h>
+#include <atomic>
+#include <mutex>
+#include <tuple> // std::get, std::tuple_size
+#include <type_traits>
+#include <utility> // std::forward, std::index_sequence
+#include <vector>
 
 #if !defined(RefCoutingObject_DEBUGTRACE)
 #   define RefCoutingObject_DEBUGTRACE()
 #endif
 
+#if defined(RCO_ENABLE_STATS)
+#   include "RefCountingObjectStats.h"
+#   define RefCountingObject_STATS(_Event_) RefCountingObjectStats::_Event_<T>()
+#else
+#   define RefCountingObject_STATS(_Event_)
+#endif
+
 #if !defined(RefCountingObject_ASSERT)
 #   include <cassert>
 #   define RefCountingObject_ASSERT(_Expr_) assert(_Expr_)
 #endif
 
+template<class T> class RefCountingObjectPtr;
+
+// Garbage collector helpers for members listed in `GCMembers()`, see `RefCountingObjectTraits::garbage_collected`.
+template<class U> void RefCountingObjectEnumGCMember(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, RefCountingObjectPtr<U>& ptr)
+{
+    if (ptr.GetRef())
+        engine->GCEnumCallback(ptr.GetRef());
+}
+
+template<class U> void RefCountingObjectEnumGCMember(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, std::vector<RefCountingObjectPtr<U>>& vec)
+{
+    for (RefCountingObjectPtr<U>& ptr: vec)
+        RefCountingObjectEnumGCMember(engine, ptr);
+}
+
+/// Threading policy: plain `int` counter, for objects used by a single thread only (default).
+struct RefCountingObjectSingleThreaded
+{
+    typedef int CounterType;
+
+    struct MutexType { void lock() {} void unlock() {} }; //!< No-op, for allocators etc.
+
+    static const bool HAS_GC_FLAG = true;
+    static const int GC_FLAG = 1 << 30; //!< Packed into the counter, see `RefCountingObjectTraits::garbage_collected`.
+
+    static void Increment(CounterType& counter, int n) { counter += n; }
+    template<class TObject> static bool DecrementIsZero(CounterType& counter, int n, TObject* /*obj*/) { return ((counter -= n) & ~GC_FLAG) == 0; }
+    static int Get(const CounterType& counter) { return counter & ~GC_FLAG; }
+
+    static void SetGCFlag(CounterType& counter) { counter |= GC_FLAG; }
+    static bool GetGCFlag(const CounterType& counter) { return (counter & GC_FLAG) != 0; }
+    static void ClearGCFlag(CounterType& counter) { counter &= ~GC_FLAG; }
+};
+
+/// Threading policy: atomic counter, for objects shared between threads (i.e. multiple script contexts).
+/// Increment is relaxed - a new reference can only be created from an existing one;
+/// decrement is acq_rel so that all writes to the object happen-before its destruction.
+struct RefCountingObjectMultiThreaded
+{
+    typedef std::atomic<int> CounterType;
+
+    typedef std::mutex MutexType;
+
+    static const bool HAS_GC_FLAG = true;
+    static const int GC_FLAG = 1 << 30; //!< Packed into the counter, see `RefCountingObjectTraits::garbage_collected`.
+
+    static void Increment(CounterType& counter, int n) { counter.fetch_add(n, std::memory_order_relaxed); }
+    template<class TObject> static bool DecrementIsZero(CounterType& counter, int n, TObject* /*obj*/) { return (counter.fetch_sub(n, std::memory_order_acq_rel) & ~GC_FLAG) == n; }
+    static int Get(const CounterType& counter) { return counter.load(std::memory_order_relaxed) & ~GC_FLAG; }
+
+    static void SetGCFlag(CounterType& counter) { counter.fetch_or(GC_FLAG, std::memory_order_relaxed); }
+    static bool GetGCFlag(const CounterType& counter) { return (counter.load(std::memory_order_relaxed) & GC_FLAG) != 0; }
+    static void ClearGCFlag(CounterType& counter)
+    {
+        if (counter.load(std::memory_order_relaxed) & GC_FLAG) // Avoid the RMW in the common case.
+            counter.fetch_and(~GC_FLAG, std::memory_order_relaxed);
+    }
+};
+
+/// Per-type options. To customize, specialize `RefCountingObjectTraits` for your type
+/// (deriving from this struct to keep the defaults) before your type is defined.
+struct RefCountingObjectDefaultTraits
+{
+    /// If false, `Release()` deletes through `T*` and no vtable is needed (saves a pointer per object and an indirect call).
+    /// Only for types which are never derived from - the type must be `final`.
+    static constexpr bool virtual_destructor = true;
+
+    /// If true, `RefCountingObjectPtr<T>` is registered without `asOBJ_GC`, so script objects and arrays
+    /// holding it aren't tracked by the garbage collector on its account.
+    /// Only for types which can never (even indirectly) hold a reference back - cycles would leak.
+    static constexpr bool acyclic = false;
+
+    /// If true, the type is registered with `asOBJ_GC` and the garbage collector behaviours, so that cycles
+    /// through C++ objects holding handles can be collected. The type must declare which members hold references:
+    ///     static auto GCMembers() { return std::make_tuple(&Foo::m_a, &Foo::m_b); } // `RefCountingObjectPtr<>` or `std::vector<RefCountingObjectPtr<>>` members
+    /// The GC flag is packed into the refcount; not supported by `RefCountingObjectBiased`.
+    static constexpr bool garbage_collected = false;
+};
+
+template<class T> struct RefCountingObjectTraits: RefCountingObjectDefaultTraits {};
+
+/// Base of `RefCountingObject` - decides whether destructor is virtual.
+template<bool VirtualDestructor> class RefCountingObjectDestructor
+{
+public:
+    virtual ~RefCountingObjectDestructor() {}
+};
+
+template<> class RefCountingObjectDestructor<false>
+{
+protected:
+    ~RefCountingObjectDestructor() {}
+};
+
 /// Self reference-counting objects, as requred by AngelScript garbage collector.
-template<class T> class RefCountingObject
+/// @param TPolicy Threading policy, see `RefCountingObjectSingleThreaded`, `RefCountingObjectMultiThreaded`
+///                and `RefCountingObjectBiased` (in RefCountingObjectBiased.h).
+template<class T, class TPolicy = RefCountingObjectSingleThreaded> class RefCountingObject
+    : public RefCountingObjectDestructor<RefCountingObjectTraits<T>::virtual_destructor>
 {
+    static_assert(!RefCountingObjectTraits<T>::garbage_collected || TPolicy::HAS_GC_FLAG,
+        "RefCountingObject: threading policy can't hold the GC flag, `garbage_collected` isn't supported");
+    // `T` is still incomplete here - the `virtual_destructor = false` check is in the destructor, which every `T` instantiates.
+
 public:
+    typedef TPolicy ThreadingPolicy; //!< For mixins which must match it, see `RefCountingObjectPooled`.
+
     RefCountingObject()
     {
+        RefCountingObject_STATS(OnConstructed);
         RefCoutingObject_DEBUGTRACE();
     }
 
-    virtual ~RefCountingObject()
+    ~RefCountingObject() // Virtual unless disabled by `RefCountingObjectTraits<T>::virtual_destructor`
     {
+        static_assert(RefCountingObjectTraits<T>::virtual_destructor || std::is_final<T>::value,
+            "RefCountingObject: type with `virtual_destructor = false` must be final, or a derived object could be deleted as `T`");
+        RefCountingObject_STATS(OnDestroyed);
         RefCoutingObject_DEBUGTRACE();
     }
 
-    void AddRef()
+    void AddRef() { this->AddRef(1); }
+    void Release() { this->Release(1); }
+
+    /// Adds `n` references at once - i.e. when copying a container with many duplicate pointers.
+    void AddRef(int n)
     {
-        m_refcount++;
+        RefCountingObject_ASSERT(n > 0);
+        this->ClearGCFlag(IsGarbageCollected()); // Object is alive, as far as the GC is concerned.
+        TPolicy::Increment(m_refcount, n);
+        RefCountingObject_STATS(OnAddRef);
         RefCoutingObject_DEBUGTRACE();
     }
 
-    void Release()
+    /// Releases `n` references at once.
+    void Release(int n)
     {
-        m_refcount--;
+        RefCountingObject_ASSERT(n > 0);
+
+        // While the weak flag is locked, weak refs cannot be resolved (see `RefCountingObjectWeakPtr::Lock()`).
+        AS_NAMESPACE_QUALIFIER asILockableSharedBool* weakref_flag = m_weakref_flag.load(std::memory_order_acquire);
+        if (weakref_flag)
+            weakref_flag->Lock();
+
+        this->ClearGCFlag(IsGarbageCollected());
+        const bool is_zero = TPolicy::DecrementIsZero(m_refcount, n, static_cast<T*>(this));
+        RefCountingObject_STATS(OnRelease);
         RefCoutingObject_DEBUGTRACE();
-        if (m_refcount == 0)
+
+        if (weakref_flag)
         {
-            delete this; // commit suicide! This is legit in C++
+            if (is_zero)
+                weakref_flag->Set(true);
+            weakref_flag->Unlock();
+            if (is_zero)
+            {
+                weakref_flag->Release();
+                T::Destroy(static_cast<T*>(this));
+            }
         }
+        else if (is_zero)
+        {
+            this->DestroyUnreferenced();
+        }
+    }
+
+    int GetRefCount() const
+    {
+        return TPolicy::Get(m_refcount);
+    }
+
+    /// Creates the weak ref flag on first use, so that objects without weak refs pay nothing.
+    /// The flag is set to `true` when the object dies; used by `RefCountingObjectWeakPtr` and AngelScript's `weakref<>`.
+    AS_NAMESPACE_QUALIFIER asILockableSharedBool* GetWeakRefFlag()
+    {
+        AS_NAMESPACE_QUALIFIER asILockableSharedBool* weakref_flag = m_weakref_flag.load(std::memory_order_acquire);
+        if (!weakref_flag)
+        {
+            AS_NAMESPACE_QUALIFIER asAcquireExclusiveLock();
+            weakref_flag = m_weakref_flag.load(std::memory_order_relaxed);
+            if (!weakref_flag)
+            {
+                weakref_flag = AS_NAMESPACE_QUALIFIER asCreateLockableSharedBool();
+                m_weakref_flag.store(weakref_flag, std::memory_order_release);
+            }
+            AS_NAMESPACE_QUALIFIER asReleaseExclusiveLock();
+        }
+        return weakref_flag;
+    }
+
+    /// Allocation customization point; to be used by factory functions.
+    /// Types with custom `Destroy()` should also provide matching `Create()`.
+    /// Garbage collected types are reported to the GC here - custom `Create()` must call `NotifyGarbageCollector()`.
+    template<typename... TArgs> static T* Create(TArgs&&... args)
+    {
+        T* obj = new T(std::forward<TArgs>(args)...);
+        RefCountingObject::NotifyGarbageCollector(obj, IsGarbageCollected());
+        return obj;
+    }
+
+    /// Destruction customization point, invoked by `Release()` when refcount reaches 0.
+    /// To use a freelist/custom allocator, define `static void Destroy(T*)` in your type - it hides this one.
+    static void Destroy(T* obj)
+    {
+        delete obj;
+    }
+
+    // Garbage collector behaviours, registered if `RefCountingObjectTraits<T>::garbage_collected`.
+    void SetGCFlag() { TPolicy::SetGCFlag(m_refcount); }
+    bool GetGCFlag() const { return TPolicy::GetGCFlag(m_refcount); }
+
+    void EnumGCReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine)
+    {
+        typedef decltype(T::GCMembers()) TMembers;
+        this->EnumGCMembers(engine, T::GCMembers(), std::make_index_sequence<std::tuple_size<TMembers>::value>());
+    }
+
+    void ReleaseGCReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine* /*engine*/)
+    {
+        typedef decltype(T::GCMembers()) TMembers;
+        this->ReleaseGCMembers(T::GCMembers(), std::make_index_sequence<std::tuple_size<TMembers>::value>());
+    }
+
+    /// Hands the new object to the garbage collector of `engine` (which keeps a reference until it finds the object unreachable).
+    /// Objects aren't tracked if the type isn't registered with `engine`.
+    static void NotifyGarbageCollector(T* obj, AS_NAMESPACE_QUALIFIER asIScriptEngine* engine)
+    {
+        AS_NAMESPACE_QUALIFIER asITypeInfo* type_info = (engine) ? static_cast<AS_NAMESPACE_QUALIFIER asITypeInfo*>(engine->GetUserData(GCUserDataKey())) : nullptr;
+        if (type_info)
+            engine->NotifyGarbageCollectorOfNewObject(obj, type_info);
+    }
+
+    /// Uses the engine of the calling script; from C++ (no active context) the engine which registered the type last.
+    /// With multiple engines, objects created from C++ should be passed to the overload above instead.
+    static void NotifyGarbageCollector(T* obj)
+    {
+        AS_NAMESPACE_QUALIFIER asIScriptContext* ctx = AS_NAMESPACE_QUALIFIER asGetActiveContext();
+        RefCountingObject::NotifyGarbageCollector(obj, (ctx) ? ctx->GetEngine() : GCDefaultEngine().load(std::memory_order_acquire));
     }
 
     static void  RegisterRefCountingObject(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* name)
@@ -55,15 +278,117 @@ public:
         using namespace AngelScript;
 #endif
 
+        const bool gc = RefCountingObjectTraits<T>::garbage_collected;
+
         // Registering the reference type
-        r = engine->RegisterObjectType(name, 0, asOBJ_REF); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectType(name, 0, asOBJ_REF | (gc ? asOBJ_GC : 0)); RefCountingObject_ASSERT( r >= 0 );
+        const int type_id = r;
+#if defined(RCO_ENABLE_STATS)
+        RefCountingObjectStats::SetTypeName<T>(name);
+#endif
 
         // Registering the addref/release behaviours
-        r = engine->RegisterObjectBehaviour(name, asBEHAVE_ADDREF, "void f()", asMETHOD(T,AddRef), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
-        r = engine->RegisterObjectBehaviour(name, asBEHAVE_RELEASE, "void f()", asMETHOD(T,Release), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_ADDREF, "void f()", asMETHODPR(T,AddRef,(),void), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_RELEASE, "void f()", asMETHODPR(T,Release,(),void), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+        // Registering the weak ref flag (enables `weakref<>` in script)
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_GET_WEAKREF_FLAG, "int &f()", asMETHOD(T,GetWeakRefFlag), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+        // Registering the garbage collector behaviours
+        RefCountingObject::RegisterGCBehaviours(engine, name, type_id, IsGarbageCollected());
+    }
+
+    typename TPolicy::CounterType m_refcount{0};
+    std::atomic<AS_NAMESPACE_QUALIFIER asILockableSharedBool*> m_weakref_flag{nullptr};
+
+protected:
+    friend TPolicy; // May finish a deferred decrement, see `RefCountingObjectBiased`.
+
+    // The GC-only paths are picked by overload (tag dispatch), so that non-GC types need neither `GCMembers()`
+    // nor a policy with the GC flag.
+    typedef std::integral_constant<bool, RefCountingObjectTraits<T>::garbage_collected> IsGarbageCollected;
+
+    void ClearGCFlag(std::true_type) { TPolicy::ClearGCFlag(m_refcount); }
+    void ClearGCFlag(std::false_type) {}
+
+    static void NotifyGarbageCollector(T* obj, std::true_type) { RefCountingObject::NotifyGarbageCollector(obj); }
+    static void NotifyGarbageCollector(T*, std::false_type) {}
+
+    static void RegisterGCBehaviours(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* name, int type_id, std::true_type)
+    {
+        int r;
+
+#if defined(AS_USE_NAMESPACE)
+        using namespace AngelScript;
+#endif
+
+        // The type info is kept by the engine itself, so it can't outlive it and each engine has its own.
+        engine->SetUserData(engine->GetTypeInfoById(type_id), GCUserDataKey());
+        engine->SetEngineUserDataCleanupCallback(&RefCountingObject::GCEngineCleanup, GCUserDataKey());
+        GCDefaultEngine().store(engine, std::memory_order_release);
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_GETREFCOUNT, "int f()", asMETHOD(T,GetRefCount), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_SETGCFLAG, "void f()", asMETHOD(T,SetGCFlag), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_GETGCFLAG, "bool f()", asMETHOD(T,GetGCFlag), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_ENUMREFS, "void f(int&in)", asMETHOD(T,EnumGCReferences), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        r = engine->RegisterObjectBehaviour(name, asBEHAVE_RELEASEREFS, "void f(int&in)", asMETHOD(T,ReleaseGCReferences), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+        (void)r;
+    }
+    static void RegisterGCBehaviours(AS_NAMESPACE_QUALIFIER asIScriptEngine*, const char*, int, std::false_type) {}
+
+    // `GCMembers()` is a tuple of member pointers, walked by index (`int expand[]` stands in for a fold expression).
+
+    template<class TMembers, size_t... I> void EnumGCMembers(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const TMembers& members, std::index_sequence<I...>)
+    {
+        T* self = static_cast<T*>(this);
+        int expand[] = { 0, (RefCountingObjectEnumGCMember(engine, self->*std::get<I>(members)), 0)... };
+        (void)expand; (void)self;
+    }
+
+    template<class TMembers, size_t... I> void ReleaseGCMembers(const TMembers& members, std::index_sequence<I...>)
+    {
+        T* self = static_cast<T*>(this);
+        int expand[] = { 0, ((self->*std::get<I>(members)) = typename std::decay<decltype(self->*std::get<I>(members))>::type(), 0)... };
+        (void)expand; (void)self;
     }
 
-    int m_refcount = 0;
+    /// Engine user data slot holding the `asITypeInfo` of `T`; unique per type.
+    static AS_NAMESPACE_QUALIFIER asPWORD GCUserDataKey()
+    {
+        static const char key = 0;
+        return (AS_NAMESPACE_QUALIFIER asPWORD)&key;
+    }
+
+    /// Engine which registered `T` last; cleared when that engine is destroyed.
+    static std::atomic<AS_NAMESPACE_QUALIFIER asIScriptEngine*>& GCDefaultEngine()
+    {
+        static std::atomic<AS_NAMESPACE_QUALIFIER asIScriptEngine*> engine{nullptr};
+        return engine;
+    }
+
+    static void GCEngineCleanup(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine)
+    {
+        GCDefaultEngine().compare_exchange_strong(engine, nullptr);
+    }
+
+    /// To be called when refcount reached zero without holding the weak flag lock.
+    void DestroyUnreferenced()
+    {
+        // Another thread may have created the flag (while holding a reference) since the caller checked.
+        AS_NAMESPACE_QUALIFIER asILockableSharedBool* weakref_flag = m_weakref_flag.load(std::memory_order_acquire);
+        if (weakref_flag)
+        {
+            weakref_flag->Lock();
+            if (TPolicy::Get(m_refcount) != 0)
+            {
+                weakref_flag->Unlock(); // Resurrected by a weak ref meanwhile.
+                return;
+            }
+            weakref_flag->Set(true);
+            weakref_flag->Unlock();
+            weakref_flag->Release();
+        }
+        T::Destroy(static_cast<T*>(this)); // commit suicide! This is legit in C++
+    }
 };
 
 /*
@@ -0,0 +1,215 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include <angelscript.h>
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <cstring> // memset
+#include <new> // ::operator new
+#include <type_traits>
+#include <utility> // std::forward
+#include <vector>
+
+#if !defined(RefCountingObjectArena_ASSERT)
+#   include <cassert>
+#   define RefCountingObjectArena_ASSERT(_Expr_) assert(_Expr_)
+#endif
+
+// Checks for handles which outlived the arena reset; on by default in debug builds.
+#if !defined(RCO_ARENA_CHECKS) && !defined(NDEBUG)
+#   define RCO_ARENA_CHECKS
+#endif
+
+struct RefCountingObjectArenaStats
+{
+    size_t blocks = 0;     //!< Number of allocated blocks.
+    size_t bytes_used = 0; //!< Bytes handed out since last reset (including alignment padding).
+    size_t objects = 0;    //!< Objects created since last reset.
+};
+
+/// Bump allocator for objects which all die at once (i.e. at end of frame or request).
+/// `Reset()` destroys all objects and rewinds the memory; blocks are kept for reuse.
+/// Not thread safe - use one arena per thread.
+class RefCountingObjectArena
+{
+public:
+    explicit RefCountingObjectArena(size_t block_size = 64 * 1024): m_block_size(block_size) {}
+    RefCountingObjectArena(const RefCountingObjectArena&) = delete;
+    RefCountingObjectArena& operator=(const RefCountingObjectArena&) = delete;
+
+    ~RefCountingObjectArena()
+    {
+        this->Reset();
+        for (Block& block: m_blocks)
+            ::operator delete(block.data);
+    }
+
+    void* Allocate(size_t size, size_t align)
+    {
+        RefCountingObjectArena_ASSERT(align != 0 && (align & (align - 1)) == 0);
+        for (;;)
+        {
+            if (m_block_index < m_blocks.size())
+            {
+                Block& block = m_blocks[m_block_index];
+                const uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+                const uintptr_t start = (base + m_offset + align - 1) & ~(uintptr_t)(align - 1);
+                if (start + size <= base + block.size)
+                {
+                    m_stats.bytes_used += (start + size) - (base + m_offset);
+                    m_offset = (start + size) - base;
+                    return reinterpret_cast<void*>(start);
+                }
+                m_block_index++; // The rest of this block is wasted until reset.
+                m_offset = 0;
+                continue;
+            }
+
+            // Oversized requests get a block of their own.
+            Block block;
+            block.size = (size + align > m_block_size) ? size + align : m_block_size;
+            block.data = static_cast<char*>(::operator new(block.size));
+            m_blocks.push_back(block);
+            m_stats.blocks++;
+        }
+    }
+
+    /// Constructs object in the arena; its destructor runs on `Reset()` (unless trivial).
+    template<class T, typename... TArgs> T* Create(TArgs&&... args)
+    {
+        T* obj = new(this->Allocate(sizeof(T), alignof(T))) T(std::forward<TArgs>(args)...);
+        if (!std::is_trivially_destructible<T>::value)
+            m_destructors.push_back({ &RefCountingObjectArena::DestroyObject<T>, obj });
+        m_stats.objects++;
+        return obj;
+    }
+
+    /// Destroys all objects (newest first) and makes the memory available again.
+    void Reset()
+    {
+        for (size_t i = m_destructors.size(); i > 0; i--)
+            m_destructors[i - 1].destroy(m_destructors[i - 1].obj);
+        m_destructors.clear();
+
+#if defined(RCO_ARENA_CHECKS)
+        // Poison, so that escaped handles fail the generation check (until the memory is reused).
+        for (size_t i = 0; i < m_blocks.size() && i <= m_block_index; i++)
+            memset(m_blocks[i].data, POISON, (i == m_block_index) ? m_offset : m_blocks[i].size);
+#endif
+        m_block_index = 0;
+        m_offset = 0;
+        m_generation++;
+        m_stats.bytes_used = 0;
+        m_stats.objects = 0;
+    }
+
+    unsigned GetGeneration() const { return m_generation; }
+    RefCountingObjectArenaStats GetStats() const { return m_stats; }
+
+    static const int POISON = 0xDD;
+
+private:
+    struct Block
+    {
+        char* data;
+        size_t size;
+    };
+
+    struct Destructor
+    {
+        void (*destroy)(void*);
+        void* obj;
+    };
+
+    template<class T> static void DestroyObject(void* obj) { static_cast<T*>(obj)->~T(); }
+
+    std::vector<Block> m_blocks;
+    std::vector<Destructor> m_destructors;
+    size_t m_block_size;
+    size_t m_block_index = 0;
+    size_t m_offset = 0; //!< Into current block.
+    unsigned m_generation = 0;
+    RefCountingObjectArenaStats m_stats;
+};
+
+/// Base for arena-owned objects, registered as `asOBJ_NOCOUNT` - an alternative to `RefCountingObject`.
+/// `AddRef()`/`Release()` do no counting, so `RefCountingObjectPtr<T>` compiles down to a raw pointer.
+/// With RCO_ARENA_CHECKS they assert the arena wasn't reset since the object was created.
+/// The handle type is registered by `RefCountingObjectPtr<T>::RegisterRefCountingObjectPtr()` as usual, which adds `asOBJ_GC`
+/// unless `RefCountingObjectTraits<T>::acyclic` is set - set it, the arena reset (not the GC) destroys these objects.
+///
+/// Usage: `class Foo: public RefCountingObjectArenaObject<Foo> {}`, `Foo* f = Foo::Create(arena)`
+template<class T>
+class RefCountingObjectArenaObject
+{
+public:
+    void AddRef() { this->CheckAlive(); }
+    void Release() { this->CheckAlive(); }
+    void AddRef(int /*n*/) { this->CheckAlive(); }
+    void Release(int /*n*/) { this->CheckAlive(); }
+
+    template<typename... TArgs> static T* Create(RefCountingObjectArena& arena, TArgs&&... args)
+    {
+        T* obj = arena.Create<T>(std::forward<TArgs>(args)...);
+#if defined(RCO_ARENA_CHECKS)
+        obj->m_arena = &arena;
+        obj->m_arena_generation = arena.GetGeneration();
+#endif
+        return obj;
+    }
+
+    static void RegisterRefCountingObject(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* name)
+    {
+        int r;
+
+#if defined(AS_USE_NAMESPACE)
+        using namespace AngelScript;
+#endif
+
+        // Script handles don't count either - no ADDREF/RELEASE behaviours.
+        r = engine->RegisterObjectType(name, 0, asOBJ_REF | asOBJ_NOCOUNT); RefCountingObjectArena_ASSERT( r >= 0 );
+    }
+
+protected:
+    void CheckAlive() const
+    {
+#if defined(RCO_ARENA_CHECKS)
+        static const unsigned POISONED = 0x01010101u * RefCountingObjectArena::POISON;
+        RefCountingObjectArena_ASSERT(m_arena_generation != POISONED && "handle outlived arena reset");
+        RefCountingObjectArena_ASSERT(m_arena->GetGeneration() == m_arena_generation && "handle outlived arena reset");
+#endif
+    }
+
+#if defined(RCO_ARENA_CHECKS)
+    RefCountingObjectArena* m_arena = nullptr;
+    unsigned m_arena_generation = 0;
+#endif
+};
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,147 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObjectPtr.h"
+
+#include <climits> // INT_MAX
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <vector>
+
+/// Accumulates `AddRef()` or `Release()` calls and applies them per object at once, via `AddRef(n)`/`Release(n)`.
+/// Made for containers with many duplicate pointers to a few objects; pointers are grouped in a small
+/// direct-mapped table, so with many distinct objects it degrades to one call per pointer (never worse).
+template<class T>
+class RefCountingObjectBatch
+{
+public:
+    enum Op { ADDREF, RELEASE };
+
+    explicit RefCountingObjectBatch(Op op): m_op(op) {}
+    ~RefCountingObjectBatch() { this->Flush(); }
+
+    RefCountingObjectBatch(const RefCountingObjectBatch&) = delete;
+    RefCountingObjectBatch& operator=(const RefCountingObjectBatch&) = delete;
+
+    void Add(T* ref)
+    {
+        if (!ref)
+            return;
+
+        const uintptr_t bits = reinterpret_cast<uintptr_t>(ref);
+        Slot& slot = m_slots[((bits >> 4) ^ (bits >> 10)) % SLOTS];
+        if (slot.ref != ref || slot.count == INT_MAX)
+        {
+            this->FlushSlot(slot);
+            slot.ref = ref;
+        }
+        slot.count++;
+    }
+
+    void Flush()
+    {
+        for (Slot& slot: m_slots)
+            this->FlushSlot(slot);
+    }
+
+private:
+    static const size_t SLOTS = 16;
+
+    struct Slot
+    {
+        T* ref = nullptr;
+        int count = 0;
+    };
+
+    void FlushSlot(Slot& slot)
+    {
+        if (slot.count == 0)
+            return;
+
+        if (m_op == ADDREF)
+            slot.ref->AddRef(slot.count);
+        else
+            slot.ref->Release(slot.count);
+        slot.ref = nullptr;
+        slot.count = 0;
+    }
+
+    Slot m_slots[SLOTS];
+    Op m_op;
+};
+
+// Vector operations which adjust each object's refcount once, rather than once per element.
+
+template<class T>
+void RefCountingObjectPtrVectorClear(std::vector<RefCountingObjectPtr<T>> &vec)
+{
+    RefCountingObjectBatch<T> batch(RefCountingObjectBatch<T>::RELEASE);
+    for (RefCountingObjectPtr<T> &ptr: vec)
+        batch.Add(ptr.Detach());
+    vec.clear();
+    // Released when `batch` goes out of scope.
+}
+
+template<class T>
+void RefCountingObjectPtrVectorCopy(std::vector<RefCountingObjectPtr<T>> &dst, const std::vector<RefCountingObjectPtr<T>> &src)
+{
+    if (&dst == &src)
+        return;
+
+    RefCountingObjectPtrVectorClear(dst);
+    dst.resize(src.size());
+    RefCountingObjectBatch<T> batch(RefCountingObjectBatch<T>::ADDREF);
+    for (size_t i = 0; i < src.size(); i++)
+    {
+        T* ref = src[i].operator->();
+        batch.Add(ref);
+        dst[i].Adopt(ref); // Counted by the batch; `src` keeps the objects alive meanwhile.
+    }
+}
+
+template<class T>
+void RefCountingObjectPtrVectorFill(std::vector<RefCountingObjectPtr<T>> &dst, size_t count, const RefCountingObjectPtr<T> &value)
+{
+    RefCountingObjectPtr_ASSERT(count <= INT_MAX);
+
+    // `value` may be an element of `dst` (i.e. `Fill(v, n, v[0])`) - take the references before clearing.
+    T* ref = value.operator->();
+    if (ref && count > 0)
+        ref->AddRef(static_cast<int>(count));
+
+    RefCountingObjectPtrVectorClear(dst);
+    dst.resize(count);
+    if (!ref || count == 0)
+        return;
+
+    for (RefCountingObjectPtr<T> &ptr: dst)
+        ptr.Adopt(ref);
+}
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,220 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObject.h"
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/// Threading policy: biased reference counting, for objects used mostly by one thread (the one which created them)
+/// and only occasionally referenced from other threads.
+/// The owner thread uses a plain counter; other threads use an atomic 'shared' counter.
+/// The two are merged when the owner's counter drops to zero, or when the shared counter goes negative
+/// (i.e. a worker released a reference created by the owner) - in that case the object is queued
+/// and merged when the owner thread calls `RefCountingObjectBiased::ProcessQueue()`.
+/// Every thread which creates objects with this policy must call `ProcessQueue()` periodically (i.e. once per frame),
+/// otherwise objects released by other threads may never be destroyed.
+struct RefCountingObjectBiased
+{
+    struct CounterType
+    {
+        CounterType(int initial): owner(ThisThread()), biased(initial) {}
+
+        std::atomic<std::thread::id> owner; //!< Becomes `std::thread::id()` once merged.
+        int biased;                         //!< Touched only by owner thread.
+        std::atomic<int> shared{0};         //!< Count (may be negative) shifted by `SHARED_SHIFT`, plus flags.
+    };
+
+    typedef std::mutex MutexType;
+
+    static const int SHARED_MERGED = 1 << 0; //!< Owner's counter was merged, `shared` holds the full count.
+    static const int SHARED_QUEUED = 1 << 1; //!< Waiting in owner's merge queue; only `ProcessQueue()` may destroy the object.
+    static const int SHARED_SHIFT = 2;
+    static const int SHARED_ONE = 1 << SHARED_SHIFT;
+
+    static const bool HAS_GC_FLAG = false; //!< Counter is split between threads, no room for the GC flag.
+
+    static void Increment(CounterType& counter, int n)
+    {
+        if (counter.owner.load(std::memory_order_relaxed) == ThisThread())
+            counter.biased += n;
+        else
+            counter.shared.fetch_add(n * SHARED_ONE, std::memory_order_relaxed);
+    }
+
+    template<class TObject> static bool DecrementIsZero(CounterType& counter, int n, TObject* obj)
+    {
+        if (counter.owner.load(std::memory_order_relaxed) == ThisThread())
+        {
+            if (n < counter.biased)
+            {
+                counter.biased -= n;
+                return false;
+            }
+
+            // Merge: from now on, all threads use the shared counter.
+            n -= counter.biased; // Releasing more than the owner counted (references added by other threads) - the rest goes to shared.
+            counter.biased = 0;
+            counter.owner.store(std::thread::id(), std::memory_order_relaxed);
+            const int old_shared = counter.shared.fetch_or(SHARED_MERGED, std::memory_order_acq_rel);
+            if (n == 0)
+                return (old_shared >> SHARED_SHIFT) == 0 && !(old_shared & SHARED_QUEUED);
+        }
+
+        // Read once, before the decrement: the owner may be merging right now. If it already gave up the object
+        // (`std::thread::id()`), it is about to set `SHARED_MERGED` and will see our decrement - nothing to queue.
+        const std::thread::id owner = counter.owner.load(std::memory_order_relaxed);
+        int old_shared = counter.shared.load(std::memory_order_relaxed);
+        int new_shared;
+        do
+        {
+            new_shared = old_shared - n * SHARED_ONE;
+            if ((new_shared >> SHARED_SHIFT) < 0 && !(old_shared & (SHARED_MERGED | SHARED_QUEUED)) && owner != std::thread::id())
+                new_shared |= SHARED_QUEUED;
+        }
+        while (!counter.shared.compare_exchange_weak(old_shared, new_shared, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        if ((new_shared & SHARED_QUEUED) && !(old_shared & SHARED_QUEUED))
+        {
+            // We released a reference counted by the owner - only the owner can tell if it was the last one.
+            Enqueue(owner, obj, &RefCountingObjectBiased::MergeQueued<TObject>);
+            return false;
+        }
+
+        return (old_shared & SHARED_MERGED) && !(new_shared & SHARED_QUEUED) && (new_shared >> SHARED_SHIFT) == 0;
+    }
+
+    static int Get(const CounterType& counter)
+    {
+        const int shared = counter.shared.load(std::memory_order_relaxed);
+        if (!(shared & SHARED_MERGED) && counter.owner.load(std::memory_order_relaxed) == ThisThread())
+            return counter.biased + (shared >> SHARED_SHIFT);
+        return shared >> SHARED_SHIFT; // Can't read owner's counter from other threads.
+    }
+
+    /// Merges counters of objects owned by the calling thread which were queued by other threads,
+    /// destroying those which are no longer referenced.
+    static void ProcessQueue()
+    {
+        if (GetQueue().pending.load(std::memory_order_acquire) == 0)
+            return;
+
+        std::vector<PendingMerge> mine;
+        {
+            Queue& queue = GetQueue();
+            std::lock_guard<std::mutex> lock(queue.mutex);
+            const std::thread::id me = ThisThread();
+            for (size_t i = 0; i < queue.entries.size(); )
+            {
+                if (queue.entries[i].owner == me)
+                {
+                    mine.push_back(queue.entries[i]);
+                    queue.entries[i] = queue.entries.back();
+                    queue.entries.pop_back();
+                }
+                else
+                {
+                    i++;
+                }
+            }
+            queue.pending.fetch_sub(mine.size(), std::memory_order_release);
+        }
+
+        for (PendingMerge& entry: mine)
+        {
+            entry.merge(entry.obj);
+        }
+    }
+
+private:
+    struct PendingMerge
+    {
+        std::thread::id owner;
+        void* obj;
+        void (*merge)(void*);
+    };
+
+    struct Queue
+    {
+        std::mutex mutex;
+        std::vector<PendingMerge> entries;
+        std::atomic<size_t> pending{0};
+    };
+
+    static Queue& GetQueue()
+    {
+        // Intentionally leaked - objects held by globals may be released after static destructors ran.
+        static Queue* queue = new Queue();
+        return *queue;
+    }
+
+    static void Enqueue(std::thread::id owner, void* obj, void (*merge)(void*))
+    {
+        Queue& queue = GetQueue();
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.entries.push_back(PendingMerge{ owner, obj, merge });
+        queue.pending.fetch_add(1, std::memory_order_release);
+    }
+
+    /// Runs on owner thread: adds owner's counter to the shared one and clears the queued flag.
+    template<class TObject> static void MergeQueued(void* ptr)
+    {
+        TObject* obj = static_cast<TObject*>(ptr);
+        CounterType& counter = obj->m_refcount;
+
+        int biased = 0;
+        if (counter.owner.load(std::memory_order_relaxed) != std::thread::id())
+        {
+            biased = counter.biased;
+            counter.biased = 0;
+            counter.owner.store(std::thread::id(), std::memory_order_relaxed);
+        }
+
+        int old_shared = counter.shared.load(std::memory_order_relaxed);
+        int new_shared;
+        do
+        {
+            new_shared = ((old_shared + biased * SHARED_ONE) | SHARED_MERGED) & ~SHARED_QUEUED;
+        }
+        while (!counter.shared.compare_exchange_weak(old_shared, new_shared, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+        if ((new_shared >> SHARED_SHIFT) == 0)
+            obj->DestroyUnreferenced();
+    }
+
+    static std::thread::id ThisThread()
+    {
+        thread_local std::thread::id id = std::this_thread::get_id();
+        return id;
+    }
+};
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
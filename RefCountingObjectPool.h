@@ -0,0 +1,146 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObject.h"
+
+#include <cstddef> // size_t
+#include <new> // ::operator new
+
+#if !defined(RefCountingObjectPool_ASSERT)
+#   include <cassert>
+#   define RefCountingObjectPool_ASSERT(_Expr_) assert(_Expr_)
+#endif
+
+struct RefCountingObjectPoolStats
+{
+    size_t slabs = 0; //!< Number of allocated slabs.
+    size_t live = 0;  //!< Slots occupied by live objects.
+    size_t free = 0;  //!< Slots available for reuse.
+};
+
+/// Mixin which allocates objects of type T from per-type fixed-size slabs, keeping them contiguous.
+/// Freed slots are reused in LIFO order (the most recently freed, and thus cache-hot, slot goes first).
+/// Objects of types derived from T (different size) fall back to global `new`/`delete`.
+/// The pool is guarded by a mutex if T's threading policy is (`RefCountingObject<T, TPolicy>::ThreadingPolicy`),
+/// so objects shared between threads are also allocated and freed safely from any thread.
+/// @param SlabObjects Number of objects per slab.
+///
+/// Usage: `class Foo: public RefCountingObject<Foo>, public RefCountingObjectPooled<Foo> {}`
+template<class T, size_t SlabObjects = 256>
+class RefCountingObjectPooled
+{
+public:
+    static void* operator new(size_t size)
+    {
+        if (size != sizeof(T))
+            return ::operator new(size);
+
+        Pool& pool = GetPool();
+        std::lock_guard<typename Pool::MutexType> lock(pool.mutex);
+        if (!pool.freelist)
+            pool.AllocSlab();
+
+        FreeSlot* slot = pool.freelist;
+        pool.freelist = slot->next;
+        pool.stats.free--;
+        pool.stats.live++;
+        return slot;
+    }
+
+    static void operator delete(void* ptr, size_t size)
+    {
+        if (!ptr)
+            return;
+
+        if (size != sizeof(T))
+        {
+            ::operator delete(ptr);
+            return;
+        }
+
+        Pool& pool = GetPool();
+        std::lock_guard<typename Pool::MutexType> lock(pool.mutex);
+        FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+        slot->next = pool.freelist;
+        pool.freelist = slot;
+        pool.stats.free++;
+        pool.stats.live--;
+    }
+
+    static RefCountingObjectPoolStats GetPoolStats()
+    {
+        Pool& pool = GetPool();
+        std::lock_guard<typename Pool::MutexType> lock(pool.mutex);
+        return pool.stats;
+    }
+
+private:
+    struct FreeSlot
+    {
+        FreeSlot* next;
+    };
+
+    struct Pool
+    {
+        typedef typename T::ThreadingPolicy::MutexType MutexType; // Here rather than at class scope - T is complete by the time `Pool` is used.
+
+        static constexpr size_t SLOT_ALIGN = (alignof(T) > alignof(FreeSlot)) ? alignof(T) : alignof(FreeSlot);
+        static constexpr size_t SLOT_SIZE = ((((sizeof(T) > sizeof(FreeSlot)) ? sizeof(T) : sizeof(FreeSlot)) + SLOT_ALIGN - 1) / SLOT_ALIGN) * SLOT_ALIGN;
+
+        void AllocSlab()
+        {
+            static_assert(SlabObjects > 0, "RefCountingObjectPooled: SlabObjects must be nonzero");
+            static_assert(SLOT_ALIGN <= alignof(std::max_align_t), "RefCountingObjectPooled: over-aligned types are not supported");
+
+            char* slab = static_cast<char*>(::operator new(SLOT_SIZE * SlabObjects));
+            // Link in reverse so that the slab is handed out front-to-back.
+            for (size_t i = SlabObjects; i > 0; i--)
+            {
+                FreeSlot* slot = reinterpret_cast<FreeSlot*>(slab + (i - 1) * SLOT_SIZE);
+                slot->next = freelist;
+                freelist = slot;
+            }
+            stats.slabs++;
+            stats.free += SlabObjects;
+        }
+
+        FreeSlot* freelist = nullptr;
+        RefCountingObjectPoolStats stats;
+        MutexType mutex;
+    };
+
+    static Pool& GetPool()
+    {
+        // Intentionally leaked (slabs included) - objects held by globals may be released after static destructors ran.
+        static Pool* pool = new Pool();
+        return *pool;
+    }
+};
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
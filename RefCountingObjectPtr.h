@@ -8,22 +8,39 @@
 
 #pragma once
 
+#include "RefCountingObject.h" // RefCountingObjectTraits
+
 #include <angelscript.h>
 #include <stdio.h> // snprintf
+#include <cstddef> // std::nullptr_t
+#include <functional> // std::hash, std::less
 
 #if !defined(RefCoutingObjectPtr_DEBUGTRACE)
 #   define RefCoutingObjectPtr_DEBUGTRACE(_Expr)
 #endif
 
-#if !defined(RefCoutingObjectPtr_DEBUGTRACE_STATIC)
-#   define RefCoutingObjectPtr_DEBUGTRACE_STATIC(_Expr)
-#endif
-
 #if !defined(RefCountingObjectPtr_ASSERT)
 #   include <cassert>
 #   define RefCountingObjectPtr_ASSERT(_Expr_) assert(_Expr_)
 #endif
 
+/// Script declarations used by `RegisterRefCountingObjectPtr()`.
+/// Normally formatted at runtime; see RefCountingObjectRegistration.h for compile-time variant.
+struct RefCountingObjectPtrDecls
+{
+    const char* handle_name;
+    const char* construct_ref;    //!< "void f(Foo @&in)"
+    const char* construct_copy;   //!< "void f(const FooPtr &in)"
+    const char* opimplcast;       //!< "Foo @ opImplCast()"
+    const char* gethandle;        //!< "Foo @ GetHandle()"
+    const char* assign_ptr;       //!< "FooPtr &opHndlAssign(const FooPtr &in)"
+    const char* assign_ref;       //!< "FooPtr &opHndlAssign(const Foo @&in)"
+    const char* equals_ptr;       //!< "bool opEquals(const FooPtr &in) const"
+    const char* equals_ref;       //!< "bool opEquals(const Foo @&in) const"
+    const char* cmp_ptr;          //!< "int opCmp(const FooPtr &in) const"
+    const char* borrow;           //!< "Foo @& Borrow()"
+};
+
 template<class T>
 class RefCountingObjectPtr
 {
@@ -32,12 +49,19 @@ public:
     RefCountingObjectPtr(T* ref);
     RefCountingObjectPtr();
     RefCountingObjectPtr(const RefCountingObjectPtr<T> &other);
+    RefCountingObjectPtr(RefCountingObjectPtr<T> &&other) noexcept;
     ~RefCountingObjectPtr();
 
     // Assignments
     RefCountingObjectPtr &operator=(const RefCountingObjectPtr<T> &other);
+    RefCountingObjectPtr &operator=(RefCountingObjectPtr<T> &&other) noexcept;
     // Intentionally omitting raw-pointer assignment, for simplicity - see raw pointer constructor.
 
+    // Ownership transfer without touching the refcount
+    void swap(RefCountingObjectPtr<T> &other) noexcept { T* tmp = m_ref; m_ref = other.m_ref; other.m_ref = tmp; }
+    T* Detach() noexcept; //!< Gives up the reference without releasing it; caller becomes responsible for calling `Release()`.
+    void Adopt(T* ref); //!< Takes over a reference which was already counted (i.e. from `Detach()` or `@+` return).
+
     // Compare smart ptr
     bool operator==(const RefCountingObjectPtr<T> &o) const { return m_ref == o.m_ref; }
     bool operator!=(const RefCountingObjectPtr<T> &o) const { return m_ref != o.m_ref; }
@@ -47,8 +71,12 @@ public:
     bool operator!=(const T* o) const { return m_ref != o; }
 
     // Compare nullptr
-    bool operator==(const nullptr_t) const { return m_ref == nullptr; }
-    bool operator!=(const nullptr_t) const { return m_ref != nullptr; }
+    bool operator==(const std::nullptr_t) const { return m_ref == nullptr; }
+    bool operator!=(const std::nullptr_t) const { return m_ref != nullptr; }
+
+    // Ordering and hashing by address, for sorted/hashed containers (see also `std::hash<>` below)
+    bool operator<(const RefCountingObjectPtr<T> &o) const { return std::less<T*>()(m_ref, o.m_ref); }
+    size_t GetHash() const { return std::hash<T*>()(m_ref); }
 
     // Get the reference
     T *GetRef() { return m_ref; } // To be invoked from C++ only!!
@@ -63,6 +91,7 @@ public:
     void ReleaseReferences(AS_NAMESPACE_QUALIFIER asIScriptEngine *engine);
 
     static void RegisterRefCountingObjectPtr(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* handle_name, const char* obj_name);
+    static void RegisterRefCountingObjectPtr(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const RefCountingObjectPtrDecls& decls);
 
 protected:
 
@@ -75,59 +104,107 @@ protected:
     static void ConstructCopy(RefCountingObjectPtr<T> *self, const RefCountingObjectPtr &o) { new(self) RefCountingObjectPtr(o); }
     static void ConstructRef(RefCountingObjectPtr<T>* self, void** objhandle);
     static void Destruct(RefCountingObjectPtr<T> *self) { self->~RefCountingObjectPtr(); }
-    static T* OpImplCast(RefCountingObjectPtr<T>* self);
-    static RefCountingObjectPtr & OpAssign(RefCountingObjectPtr<T>* self, void** objhandle);
-    static bool OpEquals(RefCountingObjectPtr<T>* self, void** objhandle);
     static T* DereferenceHandle(void** objhandle);
 
+    // Hot script thunks are members, registered as THISCALL - no OBJFIRST wrapper in between.
+    T* OpImplCast();
+    T*& OpBorrow() { return m_ref; } //!< The stored handle by reference - no AddRef here; the engine counts it only if it keeps a copy.
+    RefCountingObjectPtr & OpAssign(void** objhandle);
+    bool OpEquals(void** objhandle) const { return m_ref == DereferenceHandle(objhandle); }
+    int OpCmp(const RefCountingObjectPtr &o) const { return (*this < o) ? -1 : ((o < *this) ? 1 : 0); }
+    AS_NAMESPACE_QUALIFIER asQWORD OpHash() const { return static_cast<AS_NAMESPACE_QUALIFIER asQWORD>(this->GetHash()); }
+
     T *m_ref;
 };
 
+namespace std
+{
+    template<class T>
+    struct hash<RefCountingObjectPtr<T>>
+    {
+        size_t operator()(const RefCountingObjectPtr<T> &ptr) const { return ptr.GetHash(); }
+    };
+}
+
 template<class T>
 void RefCountingObjectPtr<T>::RegisterRefCountingObjectPtr(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* handle_name, const char* obj_name)
 {
-    int r;
     const size_t DECLBUF_MAX = 300;
-    char decl_buf[DECLBUF_MAX];
+    char decl_buf[10][DECLBUF_MAX];
+
+    RefCountingObjectPtrDecls decls;
+    decls.handle_name = handle_name;
+    snprintf(decl_buf[0], DECLBUF_MAX, "void f(%s @&in)", obj_name);
+    decls.construct_ref = decl_buf[0];
+    snprintf(decl_buf[1], DECLBUF_MAX, "void f(const %s &in)", handle_name);
+    decls.construct_copy = decl_buf[1];
+    snprintf(decl_buf[2], DECLBUF_MAX, "%s @ opImplCast()", obj_name);
+    decls.opimplcast = decl_buf[2];
+    snprintf(decl_buf[3], DECLBUF_MAX, "%s @ GetHandle()", obj_name);
+    decls.gethandle = decl_buf[3];
+    snprintf(decl_buf[4], DECLBUF_MAX, "%s &opHndlAssign(const %s &in)", handle_name, handle_name);
+    decls.assign_ptr = decl_buf[4];
+    snprintf(decl_buf[5], DECLBUF_MAX, "%s &opHndlAssign(const %s @&in)", handle_name, obj_name);
+    decls.assign_ref = decl_buf[5];
+    snprintf(decl_buf[6], DECLBUF_MAX, "bool opEquals(const %s &in) const", handle_name);
+    decls.equals_ptr = decl_buf[6];
+    snprintf(decl_buf[7], DECLBUF_MAX, "bool opEquals(const %s @&in) const", obj_name);
+    decls.equals_ref = decl_buf[7];
+    snprintf(decl_buf[8], DECLBUF_MAX, "int opCmp(const %s &in) const", handle_name);
+    decls.cmp_ptr = decl_buf[8];
+    snprintf(decl_buf[9], DECLBUF_MAX, "%s @& Borrow()", obj_name);
+    decls.borrow = decl_buf[9];
+
+    RegisterRefCountingObjectPtr(engine, decls);
+}
+
+template<class T>
+void RefCountingObjectPtr<T>::RegisterRefCountingObjectPtr(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const RefCountingObjectPtrDecls& decls)
+{
+    int r;
+    const char* handle_name = decls.handle_name;
 
 #if defined(AS_USE_NAMESPACE)
     using namespace AngelScript;
 #endif
 
+    // Handles to acyclic types can't be part of a cycle, no need to have the GC scan their holders.
+    const bool gc = !RefCountingObjectTraits<T>::acyclic;
+
     // With C++11 it is possible to use asGetTypeTraits to automatically determine the flags that represent the C++ class
-    r = engine->RegisterObjectType(handle_name, sizeof(RefCountingObjectPtr), asOBJ_VALUE | asOBJ_ASHANDLE | asOBJ_GC | asGetTypeTraits<RefCountingObjectPtr>()); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectType(handle_name, sizeof(RefCountingObjectPtr), asOBJ_VALUE | asOBJ_ASHANDLE | (gc ? asOBJ_GC : 0) | asGetTypeTraits<RefCountingObjectPtr>()); RefCountingObjectPtr_ASSERT( r >= 0 );
 
     // construct/destruct
     r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, "void f()", asFUNCTION(RefCountingObjectPtr::ConstructDefault), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
-    snprintf(decl_buf, DECLBUF_MAX, "void f(%s @&in)", obj_name);
-    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, decl_buf, asFUNCTION(RefCountingObjectPtr::ConstructRef), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
-    snprintf(decl_buf, DECLBUF_MAX, "void f(const %s &in)", handle_name);
-    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, decl_buf, asFUNCTION(RefCountingObjectPtr::ConstructCopy), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, decls.construct_ref, asFUNCTION(RefCountingObjectPtr::ConstructRef), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_CONSTRUCT, decls.construct_copy, asFUNCTION(RefCountingObjectPtr::ConstructCopy), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
     r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_DESTRUCT, "void f()", asFUNCTION(RefCountingObjectPtr::Destruct), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
 
     // GC
-    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_ENUMREFS, "void f(int&in)", asMETHOD(RefCountingObjectPtr,EnumReferences), asCALL_THISCALL); RefCountingObjectPtr_ASSERT(r >= 0);
-    r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_RELEASEREFS, "void f(int&in)", asMETHOD(RefCountingObjectPtr, ReleaseReferences), asCALL_THISCALL); RefCountingObjectPtr_ASSERT(r >= 0);
+    if (gc)
+    {
+        r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_ENUMREFS, "void f(int&in)", asMETHOD(RefCountingObjectPtr,EnumReferences), asCALL_THISCALL); RefCountingObjectPtr_ASSERT(r >= 0);
+        r = engine->RegisterObjectBehaviour(handle_name, asBEHAVE_RELEASEREFS, "void f(int&in)", asMETHOD(RefCountingObjectPtr, ReleaseReferences), asCALL_THISCALL); RefCountingObjectPtr_ASSERT(r >= 0);
+    }
 
     // Cast
-    snprintf(decl_buf, DECLBUF_MAX, "%s @ opImplCast()", obj_name);
-    r = engine->RegisterObjectMethod(handle_name, decl_buf, asFUNCTION(RefCountingObjectPtr::OpImplCast), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.opimplcast, asMETHOD(RefCountingObjectPtr, OpImplCast), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
 
     // GetRef
-    snprintf(decl_buf, DECLBUF_MAX, "%s @ GetHandle()", obj_name);
-    r = engine->RegisterObjectMethod(handle_name, decl_buf, asFUNCTION(RefCountingObjectPtr::OpImplCast), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.gethandle, asMETHOD(RefCountingObjectPtr, OpImplCast), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.borrow, asMETHOD(RefCountingObjectPtr, OpBorrow), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
 
     // Assign
-    snprintf(decl_buf, DECLBUF_MAX, "%s &opHndlAssign(const %s &in)", handle_name, handle_name);
-    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHOD(RefCountingObjectPtr, operator=), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
-    snprintf(decl_buf, DECLBUF_MAX, "%s &opHndlAssign(const %s @&in)", handle_name, obj_name);
-    r = engine->RegisterObjectMethod(handle_name, decl_buf, asFUNCTION(RefCountingObjectPtr::OpAssign), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.assign_ptr, asMETHODPR(RefCountingObjectPtr, operator=, (const RefCountingObjectPtr &), RefCountingObjectPtr&), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.assign_ref, asMETHOD(RefCountingObjectPtr, OpAssign), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
 
     // Equals
-    snprintf(decl_buf, DECLBUF_MAX, "bool opEquals(const %s &in) const", handle_name);
-    r = engine->RegisterObjectMethod(handle_name, decl_buf, asMETHODPR(RefCountingObjectPtr, operator==, (const RefCountingObjectPtr &) const, bool), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
-    snprintf(decl_buf, DECLBUF_MAX, "bool opEquals(const %s @&in) const", obj_name);
-    r = engine->RegisterObjectMethod(handle_name, decl_buf, asFUNCTION(RefCountingObjectPtr::OpEquals), asCALL_CDECL_OBJFIRST); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.equals_ptr, asMETHODPR(RefCountingObjectPtr, operator==, (const RefCountingObjectPtr &) const, bool), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, decls.equals_ref, asMETHOD(RefCountingObjectPtr, OpEquals), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+
+    // Compare, hash (by address - for sorting and for use as a key)
+    r = engine->RegisterObjectMethod(handle_name, decls.cmp_ptr, asMETHOD(RefCountingObjectPtr, OpCmp), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(handle_name, "uint64 GetHash() const", asMETHOD(RefCountingObjectPtr, OpHash), asCALL_THISCALL); RefCountingObjectPtr_ASSERT( r >= 0 );
 }
 
 
@@ -152,29 +229,22 @@ inline void RefCountingObjectPtr<T>::ConstructRef(RefCountingObjectPtr<T>* self,
 }
 
 template<class T>
-inline T* RefCountingObjectPtr<T>::OpImplCast(RefCountingObjectPtr<T>* self)
+inline T* RefCountingObjectPtr<T>::OpImplCast()
 {
-    RefCoutingObjectPtr_DEBUGTRACE_STATIC(self, (T*)nullptr);
-
-    T* ref = self->GetRef();
-    if (ref)
-        ref->AddRef();
-    return ref;
-}
+    RefCoutingObjectPtr_DEBUGTRACE((T*)nullptr);
 
-template<class T>
-inline RefCountingObjectPtr<T> & RefCountingObjectPtr<T>::OpAssign(RefCountingObjectPtr<T>* self, void** objhandle)
-{
-    T* ref = DereferenceHandle(objhandle);
-    self->Set(ref);
-    return *self;
+    // Script handles returned by app functions must be counted.
+    if (m_ref)
+        m_ref->AddRef();
+    return m_ref;
 }
 
 template<class T>
-inline bool RefCountingObjectPtr<T>::OpEquals(RefCountingObjectPtr<T>* self, void** objhandle)
+inline RefCountingObjectPtr<T> & RefCountingObjectPtr<T>::OpAssign(void** objhandle)
 {
     T* ref = DereferenceHandle(objhandle);
-    return self->GetRef() == ref;
+    this->Set(ref);
+    return *this;
 }
 
 template<class T>
@@ -200,6 +270,14 @@ inline RefCountingObjectPtr<T>::RefCountingObjectPtr(const RefCountingObjectPtr<
     AddRefHandle();
 }
 
+template<class T>
+inline RefCountingObjectPtr<T>::RefCountingObjectPtr(RefCountingObjectPtr<T> &&other) noexcept
+{
+    RefCoutingObjectPtr_DEBUGTRACE(other.m_ref);
+    m_ref = other.m_ref;
+    other.m_ref = nullptr;
+}
+
 template<class T>
 inline RefCountingObjectPtr<T>::~RefCountingObjectPtr()
 {
@@ -238,6 +316,47 @@ inline RefCountingObjectPtr<T> &RefCountingObjectPtr<T>::operator =(const RefCou
     return *this;
 }
 
+template<class T>
+inline RefCountingObjectPtr<T> &RefCountingObjectPtr<T>::operator =(RefCountingObjectPtr<T> &&other) noexcept
+{
+    RefCoutingObjectPtr_DEBUGTRACE(other.m_ref);
+    if (this != &other)
+    {
+        T* old_ref = m_ref;
+        m_ref = other.m_ref;
+        other.m_ref = nullptr;
+        // Release last - the destructor may indirectly drop the object holding this pointer.
+        if (old_ref)
+            old_ref->Release();
+    }
+    return *this;
+}
+
+template<class T>
+inline T* RefCountingObjectPtr<T>::Detach() noexcept
+{
+    RefCoutingObjectPtr_DEBUGTRACE((T*)nullptr);
+    T* ref = m_ref;
+    m_ref = nullptr;
+    return ref;
+}
+
+template<class T>
+inline void RefCountingObjectPtr<T>::Adopt(T* ref)
+{
+    RefCoutingObjectPtr_DEBUGTRACE(ref);
+    if (m_ref == ref)
+    {
+        // We already hold a reference, drop the surplus one.
+        if (ref)
+            ref->Release();
+        return;
+    }
+
+    ReleaseHandle();
+    m_ref = ref;
+}
+
 template<class T>
 inline void RefCountingObjectPtr<T>::Set(T* ref)
 {
@@ -0,0 +1,206 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObject.h"
+#include "RefCountingObjectPtr.h"
+#include "RefCountingObjectBatch.h"
+
+#include <angelscript.h>
+#include <stdio.h> // snprintf
+#include <tuple>
+#include <vector>
+
+template<class T, class TPolicy> class RefCountingObjectPtrArray;
+
+template<class T, class TPolicy> struct RefCountingObjectTraits<RefCountingObjectPtrArray<T, TPolicy>>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+    static constexpr bool garbage_collected = !RefCountingObjectTraits<T>::acyclic; // Elements may refer back to the array.
+};
+
+/// Script array of `RefCountingObjectPtr<T>`, i.e. `HorsePtrArray` - a specialized alternative to `array<HorsePtr>`.
+/// Elements are stored contiguously as raw pointers (`std::vector<RefCountingObjectPtr<T>>`, which C++ can use directly
+/// via `GetVector()`), without per-element script behaviour calls; bulk operations adjust each object's refcount once.
+template<class T, class TPolicy = RefCountingObjectSingleThreaded>
+class RefCountingObjectPtrArray final: public RefCountingObject<RefCountingObjectPtrArray<T, TPolicy>, TPolicy>
+{
+public:
+    typedef RefCountingObjectPtr<T> TPtr;
+
+    RefCountingObjectPtrArray() {}
+    RefCountingObjectPtrArray(size_t size): m_items(size) {}
+
+    /// Zero-copy access for C++.
+    std::vector<TPtr>& GetVector() { return m_items; }
+
+    size_t Size() const { return m_items.size(); }
+
+    void Resize(size_t size)
+    {
+        if (size < m_items.size())
+            this->RemoveRange(size, m_items.size() - size);
+        else
+            m_items.resize(size);
+    }
+
+    void InsertAt(size_t index, const TPtr &ptr) { m_items.insert(m_items.begin() + index, ptr); }
+    void InsertLast(const TPtr &ptr) { m_items.push_back(ptr); }
+
+    void InsertLast(const RefCountingObjectPtrArray &other)
+    {
+        const size_t count = other.m_items.size(); // `other` may be `this`
+        m_items.reserve(m_items.size() + count);
+        RefCountingObjectBatch<T> batch(RefCountingObjectBatch<T>::ADDREF);
+        for (size_t i = 0; i < count; i++)
+        {
+            T* ref = other.m_items[i].operator->();
+            batch.Add(ref);
+            m_items.emplace_back();
+            m_items.back().Adopt(ref); // Counted by the batch.
+        }
+    }
+
+    void RemoveRange(size_t start, size_t count)
+    {
+        RefCountingObjectBatch<T> batch(RefCountingObjectBatch<T>::RELEASE);
+        for (size_t i = start; i < start + count; i++)
+            batch.Add(m_items[i].Detach());
+        m_items.erase(m_items.begin() + start, m_items.begin() + start + count);
+        // Released when `batch` goes out of scope - destructors may access the array.
+    }
+
+    int Find(const T* ref) const
+    {
+        for (size_t i = 0; i < m_items.size(); i++)
+        {
+            if (m_items[i] == ref)
+                return static_cast<int>(i);
+        }
+        return -1;
+    }
+
+    void Assign(const RefCountingObjectPtrArray &other) { RefCountingObjectPtrVectorCopy(m_items, other.m_items); }
+
+    static auto GCMembers() { return std::make_tuple(&RefCountingObjectPtrArray::m_items); }
+
+    static void RegisterRefCountingObjectPtrArray(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* array_name, const char* obj_name, const char* ptr_name);
+
+protected:
+
+    // Wrapper functions, to be invoked by AngelScript only!
+    static RefCountingObjectPtrArray* Factory() { RefCountingObjectPtrArray* arr = RefCountingObjectPtrArray::Create(); arr->AddRef(); return arr; }
+    static RefCountingObjectPtrArray* FactorySize(AS_NAMESPACE_QUALIFIER asUINT size) { RefCountingObjectPtrArray* arr = RefCountingObjectPtrArray::Create(size); arr->AddRef(); return arr; }
+
+    // Script methods are members, registered as THISCALL - see `RefCountingObjectPtr`.
+    TPtr* OpIndex(AS_NAMESPACE_QUALIFIER asUINT index) { return this->CheckIndex(index, 1) ? &m_items[index] : nullptr; }
+    AS_NAMESPACE_QUALIFIER asUINT ScriptLength() const { return static_cast<AS_NAMESPACE_QUALIFIER asUINT>(m_items.size()); }
+    void ScriptResize(AS_NAMESPACE_QUALIFIER asUINT size) { this->Resize(size); }
+    void ScriptReserve(AS_NAMESPACE_QUALIFIER asUINT size) { m_items.reserve(size); }
+    bool ScriptIsEmpty() const { return m_items.empty(); }
+    void ScriptClear() { this->Resize(0); }
+    void ScriptInsertAt(AS_NAMESPACE_QUALIFIER asUINT index, void** objhandle) { if (this->CheckIndex(index, 0)) this->InsertAt(index, TPtr(static_cast<T*>(*objhandle))); }
+    void ScriptInsertLast(void** objhandle) { this->InsertLast(TPtr(static_cast<T*>(*objhandle))); }
+    void ScriptInsertLastArray(const RefCountingObjectPtrArray &other) { this->InsertLast(other); }
+    void ScriptRemoveAt(AS_NAMESPACE_QUALIFIER asUINT index) { if (this->CheckIndex(index, 1)) this->RemoveRange(index, 1); }
+    void ScriptRemoveLast() { if (this->CheckIndex(0, 1)) this->RemoveRange(m_items.size() - 1, 1); }
+    void ScriptRemoveRange(AS_NAMESPACE_QUALIFIER asUINT start, AS_NAMESPACE_QUALIFIER asUINT count) { if (this->CheckIndex(start, count)) this->RemoveRange(start, count); }
+    int ScriptFindByRef(void** objhandle) const { return this->Find(static_cast<T*>(*objhandle)); }
+    RefCountingObjectPtrArray& OpAssign(const RefCountingObjectPtrArray &other) { this->Assign(other); return *this; }
+
+    /// Validates range [index, index + count) (`count` 0 means insert position); sets script exception if out of bounds.
+    bool CheckIndex(size_t index, size_t count)
+    {
+        const size_t end = (count == 0) ? index : index + count;
+        if (end <= m_items.size() && end >= index)
+            return true;
+
+        AS_NAMESPACE_QUALIFIER asIScriptContext* ctx = AS_NAMESPACE_QUALIFIER asGetActiveContext();
+        if (ctx)
+            ctx->SetException("Index out of bounds");
+        return false;
+    }
+
+    std::vector<TPtr> m_items;
+};
+
+template<class T, class TPolicy>
+void RefCountingObjectPtrArray<T, TPolicy>::RegisterRefCountingObjectPtrArray(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* array_name, const char* obj_name, const char* ptr_name)
+{
+    int r;
+    const size_t DECLBUF_MAX = 300;
+    char decl_buf[DECLBUF_MAX];
+
+#if defined(AS_USE_NAMESPACE)
+    using namespace AngelScript;
+#endif
+
+    RefCountingObjectPtrArray::RegisterRefCountingObject(engine, array_name);
+
+    // Factories
+    snprintf(decl_buf, DECLBUF_MAX, "%s@ f()", array_name);
+    r = engine->RegisterObjectBehaviour(array_name, asBEHAVE_FACTORY, decl_buf, asFUNCTION(RefCountingObjectPtrArray::Factory), asCALL_CDECL); RefCountingObject_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "%s@ f(uint)", array_name);
+    r = engine->RegisterObjectBehaviour(array_name, asBEHAVE_FACTORY, decl_buf, asFUNCTION(RefCountingObjectPtrArray::FactorySize), asCALL_CDECL); RefCountingObject_ASSERT( r >= 0 );
+
+    // Element access - elements are the registered handle type
+    snprintf(decl_buf, DECLBUF_MAX, "%s &opIndex(uint)", ptr_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, OpIndex), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "const %s &opIndex(uint) const", ptr_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, OpIndex), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+    // Size
+    r = engine->RegisterObjectMethod(array_name, "uint length() const", asMETHOD(RefCountingObjectPtrArray, ScriptLength), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(array_name, "void resize(uint)", asMETHOD(RefCountingObjectPtrArray, ScriptResize), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(array_name, "void reserve(uint)", asMETHOD(RefCountingObjectPtrArray, ScriptReserve), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(array_name, "bool isEmpty() const", asMETHOD(RefCountingObjectPtrArray, ScriptIsEmpty), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(array_name, "void clear()", asMETHOD(RefCountingObjectPtrArray, ScriptClear), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+    // Insert
+    snprintf(decl_buf, DECLBUF_MAX, "void insertAt(uint, const %s @&in)", obj_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, ScriptInsertAt), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "void insertLast(const %s @&in)", obj_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, ScriptInsertLast), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    snprintf(decl_buf, DECLBUF_MAX, "void insertLast(const %s &in)", array_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, ScriptInsertLastArray), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+    // Remove
+    r = engine->RegisterObjectMethod(array_name, "void removeAt(uint)", asMETHOD(RefCountingObjectPtrArray, ScriptRemoveAt), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(array_name, "void removeLast()", asMETHOD(RefCountingObjectPtrArray, ScriptRemoveLast), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+    r = engine->RegisterObjectMethod(array_name, "void removeRange(uint, uint)", asMETHOD(RefCountingObjectPtrArray, ScriptRemoveRange), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+    // Search
+    snprintf(decl_buf, DECLBUF_MAX, "int findByRef(const %s @&in) const", obj_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, ScriptFindByRef), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+
+    // Assign
+    snprintf(decl_buf, DECLBUF_MAX, "%s &opAssign(const %s &in)", array_name, array_name);
+    r = engine->RegisterObjectMethod(array_name, decl_buf, asMETHOD(RefCountingObjectPtrArray, OpAssign), asCALL_THISCALL); RefCountingObject_ASSERT( r >= 0 );
+}
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
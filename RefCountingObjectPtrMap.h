@@ -0,0 +1,221 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObjectPtr.h"
+
+#include <cstddef> // size_t
+#include <cstdint> // uintptr_t
+#include <utility> // std::move
+#include <vector>
+
+/// Flat hash map keyed by objects, i.e. for entity registries. Keys are owned (each key holds one reference),
+/// but stored as raw pointers - the refcount is touched once on insert and once on erase, never on lookup or rehash.
+/// Open addressing with linear probing and backward-shift deletion (no tombstones). Null keys are never stored.
+template<class T, class TValue>
+class RefCountingObjectPtrMap
+{
+public:
+    RefCountingObjectPtrMap() {}
+    ~RefCountingObjectPtrMap() { this->Clear(); }
+
+    RefCountingObjectPtrMap(const RefCountingObjectPtrMap&) = delete;
+    RefCountingObjectPtrMap& operator=(const RefCountingObjectPtrMap&) = delete;
+
+    /// Returns null if not found.
+    TValue* Find(const T* key)
+    {
+        if (m_count == 0 || !key)
+            return nullptr;
+
+        for (size_t i = this->Home(key); ; i = (i + 1) & m_mask)
+        {
+            if (m_slots[i].key == key)
+                return &m_slots[i].value;
+            if (!m_slots[i].key)
+                return nullptr;
+        }
+    }
+
+    bool Contains(const T* key) { return this->Find(key) != nullptr; }
+
+    /// Returns false (and leaves the value untouched) if the key already exists, or is null.
+    bool Insert(const RefCountingObjectPtr<T> &key, TValue value)
+    {
+        T* ref = key.operator->();
+        if (!ref || this->Find(ref))
+            return false;
+
+        ref->AddRef();
+        *this->InsertNew(ref) = std::move(value);
+        return true;
+    }
+
+    /// Inserts default value if the key doesn't exist yet.
+    /// A null key isn't inserted; it gets a scratch default value, and writes to it are lost.
+    TValue& operator[](const RefCountingObjectPtr<T> &key)
+    {
+        T* ref = key.operator->();
+        if (!ref)
+        {
+            m_null_value = TValue();
+            return m_null_value;
+        }
+        if (TValue* value = this->Find(ref))
+            return *value;
+
+        ref->AddRef();
+        return *this->InsertNew(ref);
+    }
+
+    bool Erase(const T* key)
+    {
+        if (m_count == 0 || !key)
+            return false;
+
+        size_t i = this->Home(key);
+        while (m_slots[i].key != key)
+        {
+            if (!m_slots[i].key)
+                return false;
+            i = (i + 1) & m_mask;
+        }
+
+        T* ref = m_slots[i].key;
+        m_slots[i].key = nullptr;
+        m_slots[i].value = TValue();
+        m_count--;
+
+        // Backward shift: move following entries of the cluster up, unless they'd get before their home slot.
+        for (size_t hole = i, j = (i + 1) & m_mask; m_slots[j].key; j = (j + 1) & m_mask)
+        {
+            const size_t home = this->Home(m_slots[j].key);
+            if (((j - home) & m_mask) >= ((j - hole) & m_mask))
+            {
+                m_slots[hole].key = m_slots[j].key;
+                m_slots[hole].value = std::move(m_slots[j].value);
+                m_slots[j].key = nullptr;
+                m_slots[j].value = TValue();
+                hole = j;
+            }
+        }
+
+        ref->Release(); // Last - the destructor may access the map.
+        return true;
+    }
+
+    void Clear()
+    {
+        std::vector<Slot> slots;
+        slots.swap(m_slots);
+        m_count = 0;
+        m_mask = 0;
+        for (Slot& slot: slots)
+        {
+            if (slot.key)
+                slot.key->Release();
+        }
+    }
+
+    void Reserve(size_t count)
+    {
+        size_t capacity = 8;
+        while (capacity * MAX_LOAD_NUM < count * MAX_LOAD_DEN)
+            capacity *= 2;
+        if (capacity > m_slots.size())
+            this->Rehash(capacity);
+    }
+
+    /// Calls `fn(T* key, TValue& value)` for each entry; the map must not be modified meanwhile.
+    template<class TFunc> void ForEach(TFunc fn)
+    {
+        for (Slot& slot: m_slots)
+        {
+            if (slot.key)
+                fn(slot.key, slot.value);
+        }
+    }
+
+    size_t Size() const { return m_count; }
+    bool Empty() const { return m_count == 0; }
+
+private:
+    static const size_t MAX_LOAD_NUM = 3; // Max load factor 3/4
+    static const size_t MAX_LOAD_DEN = 4;
+
+    struct Slot
+    {
+        T* key = nullptr;
+        TValue value = TValue();
+    };
+
+    size_t Home(const T* key) const
+    {
+        // Fibonacci hashing; low bits of addresses are always zero due to alignment.
+        const uint64_t bits = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(key));
+        return static_cast<size_t>((bits * 0x9E3779B97F4A7C15ull) >> 32) & m_mask;
+    }
+
+    /// The key must not be present; its reference must already be counted.
+    TValue* InsertNew(T* key)
+    {
+        if ((m_count + 1) * MAX_LOAD_DEN > m_slots.size() * MAX_LOAD_NUM)
+            this->Rehash(m_slots.empty() ? 8 : m_slots.size() * 2);
+
+        size_t i = this->Home(key);
+        while (m_slots[i].key)
+            i = (i + 1) & m_mask;
+        m_slots[i].key = key;
+        m_count++;
+        return &m_slots[i].value;
+    }
+
+    void Rehash(size_t capacity)
+    {
+        std::vector<Slot> old_slots(capacity);
+        old_slots.swap(m_slots);
+        m_mask = capacity - 1;
+        for (Slot& slot: old_slots)
+        {
+            if (!slot.key)
+                continue;
+            size_t i = this->Home(slot.key);
+            while (m_slots[i].key)
+                i = (i + 1) & m_mask;
+            m_slots[i].key = slot.key;
+            m_slots[i].value = std::move(slot.value);
+        }
+    }
+
+    std::vector<Slot> m_slots; //!< Size is power of 2
+    size_t m_mask = 0;
+    size_t m_count = 0;
+    TValue m_null_value = TValue(); //!< Returned by `operator[]` for null keys
+};
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,139 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObjectPtr.h"
+
+#include <angelscript.h>
+#include <cstddef> // std::nullptr_t
+#include <new> // placement new
+
+#if !defined(RefCountingObjectRef_ASSERT)
+#   include <cassert>
+#   define RefCountingObjectRef_ASSERT(_Expr_) assert(_Expr_)
+#endif
+
+/// Borrowed (non-owning) reference, for parameters of functions which only inspect the object.
+/// Doesn't touch the refcount at all - neither in C++ nor when passed from script -
+/// the caller's reference keeps the object alive for the duration of the call.
+/// Must not be stored; convert to owning pointer with `ToPtr()` if needed.
+///
+/// WARNING: AngelScript has no way to restrict a value type to parameters, so scripts can still declare
+/// `FooRef` globals, class members and locals. Those hold no reference and dangle silently once the object dies,
+/// i.e. after `FooRef@ r = Foo();` the temporary object is already deleted. Only use it in parameters of registered functions,
+/// and keep it out of script-facing APIs which untrusted scripts use to store state.
+template<class T>
+class RefCountingObjectRef
+{
+public:
+    // Constructors
+    RefCountingObjectRef(): m_ref(nullptr) {}
+    RefCountingObjectRef(T* ref): m_ref(ref) {}
+    RefCountingObjectRef(const RefCountingObjectPtr<T> &ptr): m_ref(ptr.operator->()) {}
+
+    // Compare
+    bool operator==(const RefCountingObjectRef<T> &o) const { return m_ref == o.m_ref; }
+    bool operator!=(const RefCountingObjectRef<T> &o) const { return m_ref != o.m_ref; }
+    bool operator==(const RefCountingObjectPtr<T> &o) const { return o == m_ref; }
+    bool operator!=(const RefCountingObjectPtr<T> &o) const { return o != m_ref; }
+    bool operator==(const std::nullptr_t) const { return m_ref == nullptr; }
+    bool operator!=(const std::nullptr_t) const { return m_ref != nullptr; }
+
+    // Get the reference
+    T* GetRef() const { return m_ref; }
+    T* operator->() const { return m_ref; }
+
+    // Boolean conversion (classic pointer check)
+    operator bool() const { return (bool)m_ref; }
+
+    /// Takes a reference (AddRef) - for when the callee decides to keep the object.
+    RefCountingObjectPtr<T> ToPtr() const { return RefCountingObjectPtr<T>(m_ref); }
+
+    /// @param ptr_name Name of registered `RefCountingObjectPtr` for `T`, to allow passing it directly; may be null.
+    static void RegisterRefCountingObjectRef(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* ref_name, const char* obj_name, const char* ptr_name = nullptr);
+
+protected:
+
+    // Wrapper functions, to be invoked by AngelScript only!
+    static void ConstructRef(RefCountingObjectRef<T>* self, void** objhandle) { new(self) RefCountingObjectRef(static_cast<T*>(*objhandle)); }
+    static void ConstructPtr(RefCountingObjectRef<T>* self, const RefCountingObjectPtr<T> &ptr) { new(self) RefCountingObjectRef(ptr); }
+    T* OpImplCast(); // THISCALL, like `RefCountingObjectPtr`
+    bool OpEquals(void** objhandle) const { return m_ref == static_cast<T*>(*objhandle); }
+
+    T* m_ref;
+};
+
+template<class T>
+void RefCountingObjectRef<T>::RegisterRefCountingObjectRef(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine, const char* ref_name, const char* obj_name, const char* ptr_name)
+{
+    int r;
+    const size_t DECLBUF_MAX = 300;
+    char decl_buf[DECLBUF_MAX];
+
+#if defined(AS_USE_NAMESPACE)
+    using namespace AngelScript;
+#endif
+
+    // POD - no destructor, so passing it from script costs no refcounting.
+    // Nothing stops scripts from storing it - see the warning at the class.
+    r = engine->RegisterObjectType(ref_name, sizeof(RefCountingObjectRef), asOBJ_VALUE | asOBJ_POD | asOBJ_ASHANDLE | asGetTypeTraits<RefCountingObjectRef>()); RefCountingObjectRef_ASSERT( r >= 0 );
+
+    // construct
+    snprintf(decl_buf, DECLBUF_MAX, "void f(%s @&in)", obj_name);
+    r = engine->RegisterObjectBehaviour(ref_name, asBEHAVE_CONSTRUCT, decl_buf, asFUNCTION(RefCountingObjectRef::ConstructRef), asCALL_CDECL_OBJFIRST); RefCountingObjectRef_ASSERT( r >= 0 );
+    if (ptr_name)
+    {
+        snprintf(decl_buf, DECLBUF_MAX, "void f(const %s &in)", ptr_name);
+        r = engine->RegisterObjectBehaviour(ref_name, asBEHAVE_CONSTRUCT, decl_buf, asFUNCTION(RefCountingObjectRef::ConstructPtr), asCALL_CDECL_OBJFIRST); RefCountingObjectRef_ASSERT( r >= 0 );
+    }
+
+    // Cast
+    snprintf(decl_buf, DECLBUF_MAX, "%s @ opImplCast()", obj_name);
+    r = engine->RegisterObjectMethod(ref_name, decl_buf, asMETHOD(RefCountingObjectRef, OpImplCast), asCALL_THISCALL); RefCountingObjectRef_ASSERT( r >= 0 );
+
+    // GetRef
+    snprintf(decl_buf, DECLBUF_MAX, "%s @ GetHandle()", obj_name);
+    r = engine->RegisterObjectMethod(ref_name, decl_buf, asMETHOD(RefCountingObjectRef, OpImplCast), asCALL_THISCALL); RefCountingObjectRef_ASSERT( r >= 0 );
+
+    // Equals
+    snprintf(decl_buf, DECLBUF_MAX, "bool opEquals(const %s @&in) const", obj_name);
+    r = engine->RegisterObjectMethod(ref_name, decl_buf, asMETHOD(RefCountingObjectRef, OpEquals), asCALL_THISCALL); RefCountingObjectRef_ASSERT( r >= 0 );
+}
+
+// ---------------------------- Internals ------------------------------
+
+template<class T>
+inline T* RefCountingObjectRef<T>::OpImplCast()
+{
+    // Handles returned to script must be counted.
+    if (m_ref)
+        m_ref->AddRef();
+    return m_ref;
+}
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
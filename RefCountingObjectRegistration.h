@@ -0,0 +1,162 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+// Registration with script declarations built at compile time.
+// Requires names in traits of each type:
+//
+//     template<> struct RefCountingObjectTraits<Foo>: RefCountingObjectDefaultTraits
+//     {
+//         static constexpr char name[] = "Foo";
+//         static constexpr char ptr_name[] = "FooPtr";
+//     };
+//
+// Before C++17 the names also need a definition in one .cpp file:
+//
+//     constexpr char RefCountingObjectTraits<Foo>::name[];
+//     constexpr char RefCountingObjectTraits<Foo>::ptr_name[];
+
+#pragma once
+
+#include "RefCountingObject.h"
+#include "RefCountingObjectPtr.h"
+
+#include <angelscript.h>
+#include <cstddef> // size_t
+
+/// Concatenates strings at compile time; `value` is a null-terminated string with static storage.
+/// The parts must have static storage too (i.e. static constexpr char arrays).
+template<const char*... Parts>
+struct RefCountingObjectJoin
+{
+    static constexpr size_t Length(const char* s)
+    {
+        size_t len = 0;
+        while (s[len] != '\0')
+            len++;
+        return len;
+    }
+
+    static constexpr size_t TotalLength()
+    {
+        size_t len = 0;
+        for (const char* part : {Parts...})
+            len += Length(part);
+        return len;
+    }
+
+    struct Buffer { char chars[TotalLength() + 1]; };
+
+    static constexpr Buffer Join()
+    {
+        Buffer buf{};
+        size_t pos = 0;
+        for (const char* part : {Parts...})
+        {
+            for (size_t i = 0; part[i] != '\0'; i++)
+                buf.chars[pos++] = part[i];
+        }
+        buf.chars[pos] = '\0';
+        return buf;
+    }
+
+    static constexpr Buffer buffer = Join();
+    static constexpr const char* value = buffer.chars;
+};
+
+template<const char*... Parts> constexpr typename RefCountingObjectJoin<Parts...>::Buffer RefCountingObjectJoin<Parts...>::buffer;
+template<const char*... Parts> constexpr const char* RefCountingObjectJoin<Parts...>::value;
+
+/// Fixed parts of `RefCountingObjectPtr` declarations, see `RefCountingObjectPtrDecls`.
+/// A template only so that the definitions below can live in this header.
+template<class TUnused = void>
+struct RefCountingObjectDeclParts
+{
+    static constexpr char void_f[] = "void f(";
+    static constexpr char void_f_const[] = "void f(const ";
+    static constexpr char handle_in[] = " @&in)";
+    static constexpr char ref_in[] = " &in)";
+    static constexpr char opimplcast[] = " @ opImplCast()";
+    static constexpr char gethandle[] = " @ GetHandle()";
+    static constexpr char ophndlassign[] = " &opHndlAssign(const ";
+    static constexpr char opequals[] = "bool opEquals(const ";
+    static constexpr char handle_in_const[] = " @&in) const";
+    static constexpr char ref_in_const[] = " &in) const";
+    static constexpr char opcmp[] = "int opCmp(const ";
+    static constexpr char borrow[] = " @& Borrow()";
+};
+
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::void_f[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::void_f_const[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::handle_in[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::ref_in[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::opimplcast[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::gethandle[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::ophndlassign[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::opequals[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::handle_in_const[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::ref_in_const[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::opcmp[];
+template<class TUnused> constexpr char RefCountingObjectDeclParts<TUnused>::borrow[];
+
+/// Declarations of `RefCountingObjectPtr<T>`, built at compile time from `RefCountingObjectTraits<T>`.
+template<class T>
+struct RefCountingObjectStaticDecls
+{
+    typedef RefCountingObjectTraits<T> Traits;
+    typedef RefCountingObjectDeclParts<> P;
+
+    static constexpr RefCountingObjectPtrDecls ptr_decls =
+    {
+        Traits::ptr_name,
+        RefCountingObjectJoin<P::void_f, Traits::name, P::handle_in>::value,
+        RefCountingObjectJoin<P::void_f_const, Traits::ptr_name, P::ref_in>::value,
+        RefCountingObjectJoin<Traits::name, P::opimplcast>::value,
+        RefCountingObjectJoin<Traits::name, P::gethandle>::value,
+        RefCountingObjectJoin<Traits::ptr_name, P::ophndlassign, Traits::ptr_name, P::ref_in>::value,
+        RefCountingObjectJoin<Traits::ptr_name, P::ophndlassign, Traits::name, P::handle_in>::value,
+        RefCountingObjectJoin<P::opequals, Traits::ptr_name, P::ref_in_const>::value,
+        RefCountingObjectJoin<P::opequals, Traits::name, P::handle_in_const>::value,
+        RefCountingObjectJoin<P::opcmp, Traits::ptr_name, P::ref_in_const>::value,
+        RefCountingObjectJoin<Traits::name, P::borrow>::value,
+    };
+};
+
+template<class T> constexpr RefCountingObjectPtrDecls RefCountingObjectStaticDecls<T>::ptr_decls;
+
+/// Registers object types `Ts...` and their `RefCountingObjectPtr<>` handle types in one call,
+/// using names from `RefCountingObjectTraits<>` - no string formatting at runtime.
+/// All object types are registered first, so handle types may refer to any of them.
+/// Note AngelScript has no batch registration API; this still makes the usual engine calls for each type.
+template<class... Ts>
+void RegisterRefCountingObjectTypes(AS_NAMESPACE_QUALIFIER asIScriptEngine* engine)
+{
+    int objs[] = { 0, (Ts::RegisterRefCountingObject(engine, RefCountingObjectTraits<Ts>::name), 0)... };
+    int ptrs[] = { 0, (RefCountingObjectPtr<Ts>::RegisterRefCountingObjectPtr(engine, RefCountingObjectStaticDecls<Ts>::ptr_decls), 0)... };
+    (void)objs; (void)ptrs;
+}
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
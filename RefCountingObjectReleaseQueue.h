@@ -0,0 +1,148 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObject.h"
+
+#include <chrono>
+#include <cstddef> // size_t
+#include <deque>
+#include <mutex>
+
+struct RefCountingObjectReleaseQueueStats
+{
+    size_t depth = 0;              //!< Objects currently waiting for destruction.
+    size_t peak_depth = 0;         //!< Highest `depth` seen so far.
+    size_t total_deferred = 0;     //!< Objects ever enqueued.
+    size_t total_destroyed = 0;    //!< Objects ever destroyed by `Drain()`.
+    double last_drain_ms = 0.0;    //!< Duration of the most recent `Drain()` call.
+    double total_drain_ms = 0.0;   //!< Accumulated duration of all `Drain()` calls.
+};
+
+/// Holds objects whose refcount reached 0 until the application destroys them at a safe point.
+/// Shared by all types using `RefCountingObjectDeferred`; safe to enqueue from any thread.
+class RefCountingObjectReleaseQueue
+{
+public:
+    typedef void (*DestroyFunc)(void*);
+
+    static RefCountingObjectReleaseQueue& Get()
+    {
+        // Intentionally leaked - objects held by globals may be released after static destructors ran.
+        static RefCountingObjectReleaseQueue* queue = new RefCountingObjectReleaseQueue();
+        return *queue;
+    }
+
+    void Enqueue(void* obj, DestroyFunc destroy)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(Entry{ obj, destroy });
+        m_stats.total_deferred++;
+        if (m_entries.size() > m_stats.peak_depth)
+            m_stats.peak_depth = m_entries.size();
+    }
+
+    /// Destroys queued objects, including those enqueued by the destructors themselves.
+    /// @param max_count Stop after destroying this many objects; 0 means no limit.
+    /// @param max_time Stop after this time is spent; zero means no limit. Checked after each object.
+    /// @return Number of objects destroyed.
+    size_t Drain(size_t max_count = 0, std::chrono::microseconds max_time = std::chrono::microseconds::zero())
+    {
+        const auto start = std::chrono::steady_clock::now();
+        size_t count = 0;
+        Entry entry;
+        while ((max_count == 0 || count < max_count) && this->Pop(entry))
+        {
+            entry.destroy(entry.obj); // May enqueue more objects.
+            count++;
+
+            if (max_time != std::chrono::microseconds::zero() && std::chrono::steady_clock::now() - start >= max_time)
+                break;
+        }
+
+        const double elapsed_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stats.total_destroyed += count;
+        m_stats.last_drain_ms = elapsed_ms;
+        m_stats.total_drain_ms += elapsed_ms;
+        return count;
+    }
+
+    RefCountingObjectReleaseQueueStats GetStats()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        RefCountingObjectReleaseQueueStats stats = m_stats;
+        stats.depth = m_entries.size();
+        return stats;
+    }
+
+private:
+    struct Entry
+    {
+        void* obj;
+        DestroyFunc destroy;
+    };
+
+    bool Pop(Entry& entry)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_entries.empty())
+            return false;
+
+        entry = m_entries.front();
+        m_entries.pop_front();
+        return true;
+    }
+
+    std::mutex m_mutex;
+    std::deque<Entry> m_entries;
+    RefCountingObjectReleaseQueueStats m_stats;
+};
+
+/// Opt-in deferred destruction: when refcount reaches 0, the object is put on `RefCountingObjectReleaseQueue`
+/// instead of being deleted right away; the application calls `RefCountingObjectReleaseQueue::Get().Drain()` at a safe point.
+///
+/// Usage: `class Foo: public RefCountingObjectDeferred<Foo> {}` instead of `RefCountingObject<Foo>`.
+template<class T, class TPolicy = RefCountingObjectSingleThreaded>
+class RefCountingObjectDeferred: public RefCountingObject<T, TPolicy>
+{
+public:
+    /// Hides `RefCountingObject::Destroy()`.
+    static void Destroy(T* obj)
+    {
+        RefCountingObjectReleaseQueue::Get().Enqueue(obj, &RefCountingObjectDeferred::DestroyNow);
+    }
+
+private:
+    static void DestroyNow(void* obj)
+    {
+        RefCountingObject<T, TPolicy>::Destroy(static_cast<T*>(obj));
+    }
+};
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,186 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+// Per-type statistics of RefCountingObject; compiled in only if `RCO_ENABLE_STATS` is defined.
+
+#pragma once
+
+#include <angelscript.h>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+struct RefCountingObjectStatsSnapshot
+{
+    std::string type_name;          //!< Script name if registered, C++ name otherwise.
+    int64_t live = 0;
+    int64_t peak_live = 0;          //!< Most objects alive at once, over all threads.
+    uint64_t constructed = 0;
+    uint64_t destroyed_from_cpp = 0;
+    uint64_t destroyed_from_script = 0; //!< Destroyed while a script context was active on the thread.
+    uint64_t addref_calls = 0;
+    uint64_t release_calls = 0;
+};
+
+class RefCountingObjectStats
+{
+public:
+    // Event hooks, invoked by `RefCountingObject`
+
+    template<class T> static void OnConstructed()
+    {
+        Bump(GetThreadCounters<T>().constructed);
+
+        // Live count is shared by all threads - per-thread peaks don't add up to a peak.
+        TypeStats& stats = GetTypeStats<T>();
+        const int64_t live = stats.live.fetch_add(1, std::memory_order_relaxed) + 1;
+        int64_t peak = stats.peak_live.load(std::memory_order_relaxed);
+        while (live > peak && !stats.peak_live.compare_exchange_weak(peak, live, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    template<class T> static void OnDestroyed()
+    {
+        ThreadCounters& counters = GetThreadCounters<T>();
+        if (AS_NAMESPACE_QUALIFIER asGetActiveContext())
+            Bump(counters.destroyed_from_script);
+        else
+            Bump(counters.destroyed_from_cpp);
+        GetTypeStats<T>().live.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    template<class T> static void OnAddRef() { Bump(GetThreadCounters<T>().addref_calls); }
+    template<class T> static void OnRelease() { Bump(GetThreadCounters<T>().release_calls); }
+
+    template<class T> static void SetTypeName(const char* name)
+    {
+        TypeStats& stats = GetTypeStats<T>();
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        stats.name = name;
+    }
+
+    /// Sums up per-thread counters of all types seen so far.
+    static std::vector<RefCountingObjectStatsSnapshot> TakeSnapshot()
+    {
+        std::vector<RefCountingObjectStatsSnapshot> result;
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> registry_lock(registry.mutex);
+        for (TypeStats* stats: registry.types)
+        {
+            RefCountingObjectStatsSnapshot snap;
+            std::lock_guard<std::mutex> lock(stats->mutex);
+            snap.type_name = stats->name;
+            snap.live = stats->live.load(std::memory_order_relaxed);
+            snap.peak_live = stats->peak_live.load(std::memory_order_relaxed);
+            for (ThreadCounters* counters: stats->threads)
+            {
+                snap.constructed += counters->constructed.load(std::memory_order_relaxed);
+                snap.destroyed_from_cpp += counters->destroyed_from_cpp.load(std::memory_order_relaxed);
+                snap.destroyed_from_script += counters->destroyed_from_script.load(std::memory_order_relaxed);
+                snap.addref_calls += counters->addref_calls.load(std::memory_order_relaxed);
+                snap.release_calls += counters->release_calls.load(std::memory_order_relaxed);
+            }
+            result.push_back(snap);
+        }
+        return result;
+    }
+
+private:
+    /// Written only by the owning thread, so plain load+store suffices (no locked instructions).
+    struct ThreadCounters
+    {
+        std::atomic<uint64_t> constructed{0};
+        std::atomic<uint64_t> destroyed_from_cpp{0};
+        std::atomic<uint64_t> destroyed_from_script{0};
+        std::atomic<uint64_t> addref_calls{0};
+        std::atomic<uint64_t> release_calls{0};
+    };
+
+    struct TypeStats
+    {
+        std::mutex mutex;
+        std::string name;
+        std::vector<ThreadCounters*> threads; //!< Kept after thread exits, so that its counts are not lost.
+        std::atomic<int64_t> live{0};         //!< Shared by all threads, one locked instruction per construction/destruction.
+        std::atomic<int64_t> peak_live{0};
+    };
+
+    struct Registry
+    {
+        std::mutex mutex;
+        std::vector<TypeStats*> types;
+    };
+
+    static void Bump(std::atomic<uint64_t>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    // Everything is intentionally leaked - objects held by globals may be released after static destructors ran.
+
+    static Registry& GetRegistry()
+    {
+        static Registry* registry = new Registry();
+        return *registry;
+    }
+
+    template<class T> static TypeStats& GetTypeStats()
+    {
+        static TypeStats* stats = RegisterType(typeid(T).name());
+        return *stats;
+    }
+
+    template<class T> static ThreadCounters& GetThreadCounters()
+    {
+        thread_local ThreadCounters* counters = RegisterThread(GetTypeStats<T>());
+        return *counters;
+    }
+
+    static TypeStats* RegisterType(const char* name)
+    {
+        TypeStats* stats = new TypeStats();
+        stats->name = name;
+        Registry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.types.push_back(stats);
+        return stats;
+    }
+
+    static ThreadCounters* RegisterThread(TypeStats& stats)
+    {
+        ThreadCounters* counters = new ThreadCounters();
+        std::lock_guard<std::mutex> lock(stats.mutex);
+        stats.threads.push_back(counters);
+        return counters;
+    }
+};
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
@@ -0,0 +1,113 @@
+// RefCountingObject system for AngelScript
+// Copyright (c) 2022 Petr Ohlidal
+// https://github.com/only-a-ptr/RefCountingObject-AngelScript
+// See license (MIT) at the bottom of this file.
+
+#pragma once
+
+#include "RefCountingObjectPtr.h"
+
+#include <angelscript.h>
+
+/// Non-owning reference to a `RefCountingObject`; doesn't keep the object alive.
+/// Uses the same weak ref flag as AngelScript's `weakref<>`, so both can observe the same objects.
+template<class T>
+class RefCountingObjectWeakPtr
+{
+public:
+    // Constructors
+    RefCountingObjectWeakPtr() {}
+    RefCountingObjectWeakPtr(const RefCountingObjectPtr<T> &ptr) { this->Set(ptr.operator->()); }
+    RefCountingObjectWeakPtr(const RefCountingObjectWeakPtr<T> &other) { this->Set(other); }
+    ~RefCountingObjectWeakPtr() { this->Reset(); }
+
+    // Assignments
+    RefCountingObjectWeakPtr &operator=(const RefCountingObjectPtr<T> &ptr) { this->Set(ptr.operator->()); return *this; }
+    RefCountingObjectWeakPtr &operator=(const RefCountingObjectWeakPtr<T> &other) { if (this != &other) { this->Set(other); } return *this; }
+
+    /// Returns owning pointer, or null if the object is already dead.
+    RefCountingObjectPtr<T> Lock() const;
+
+    bool Expired() const { return !m_weakref_flag || m_weakref_flag->Get(); }
+
+    void Reset();
+
+protected:
+    void Set(T* ref);
+    void Set(const RefCountingObjectWeakPtr<T> &other);
+
+    T* m_ref = nullptr; // Never dereferenced unless the flag says the object is alive.
+    AS_NAMESPACE_QUALIFIER asILockableSharedBool* m_weakref_flag = nullptr;
+};
+
+// ---------------------------- Internals ------------------------------
+
+template<class T>
+inline RefCountingObjectPtr<T> RefCountingObjectWeakPtr<T>::Lock() const
+{
+    RefCountingObjectPtr<T> result;
+    if (!m_weakref_flag)
+        return result;
+
+    // The object's `Release()` holds the same lock while checking for zero, so it can't die meanwhile.
+    m_weakref_flag->Lock();
+    if (!m_weakref_flag->Get())
+        result = RefCountingObjectPtr<T>(m_ref);
+    m_weakref_flag->Unlock();
+    return result;
+}
+
+template<class T>
+inline void RefCountingObjectWeakPtr<T>::Reset()
+{
+    if (m_weakref_flag)
+        m_weakref_flag->Release();
+    m_weakref_flag = nullptr;
+    m_ref = nullptr;
+}
+
+template<class T>
+inline void RefCountingObjectWeakPtr<T>::Set(T* ref)
+{
+    // Caller holds a strong reference, so `ref` is alive.
+    AS_NAMESPACE_QUALIFIER asILockableSharedBool* weakref_flag = (ref) ? ref->GetWeakRefFlag() : nullptr;
+    if (weakref_flag)
+        weakref_flag->AddRef();
+    this->Reset();
+    m_ref = ref;
+    m_weakref_flag = weakref_flag;
+}
+
+template<class T>
+inline void RefCountingObjectWeakPtr<T>::Set(const RefCountingObjectWeakPtr<T> &other)
+{
+    if (other.m_weakref_flag)
+        other.m_weakref_flag->AddRef();
+    this->Reset();
+    m_ref = other.m_ref;
+    m_weakref_flag = other.m_weakref_flag;
+}
+
+/*
+MIT License
+
+Copyright (c) 2022 Petr Ohlídal
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
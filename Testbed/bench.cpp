@@ -0,0 +1,928 @@
+#include "bench.h"
+
+// Measure the counters, not the tracing which "debug_log.h" turns on for the rest of the Testbed.
+// Only the `Bench*` types are instantiated in this file, so no other type sees the difference.
+#undef RefCoutingObject_DEBUGTRACE
+#define RefCoutingObject_DEBUGTRACE()
+#undef RefCoutingObjectPtr_DEBUGTRACE
+#define RefCoutingObjectPtr_DEBUGTRACE(_arg_)
+
+#include "context_pool.h"
+#include "../AtomicRefCountingObjectPtr.h"
+#include "../RefCountingObject.h"
+#include "../RefCountingObjectBatch.h"
+#include "../RefCountingObjectBiased.h"
+#include "../RefCountingObjectPool.h"
+#include "../RefCountingObjectPtr.h"
+#include "../RefCountingObjectPtrArray.h"
+#include "../RefCountingObjectPtrMap.h"
+#include "../RefCountingObjectRef.h"
+#include "../RefCountingObjectRegistration.h"
+
+#include <angelscript.h>
+#if defined(RCO_BENCH_SCRIPTARRAY)
+#   include <scriptarray.h> // "add_on/scriptarray" of the AngelScript SDK; scriptarray.cpp must be built too.
+#endif
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <mutex>
+#include <stdio.h>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Implemented in "main.cpp"
+void MessageCallback(const asSMessageInfo *msg, void *param);
+
+template<class TPolicy> class BenchObject;
+
+template<class TPolicy> struct RefCountingObjectTraits<BenchObject<TPolicy>>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false; // As cheap as it gets - measure the counter only.
+};
+
+template<class TPolicy>
+class BenchObject final: public RefCountingObject<BenchObject<TPolicy>, TPolicy> {};
+
+/// Nanoseconds per AddRef+Release pair on `obj`.
+template<class T>
+static double BenchAddRefRelease(T* obj, int iterations)
+{
+    T* volatile handle = obj; // Re-read each iteration, so the loop can't be folded away.
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        T* ref = handle;
+        ref->AddRef();
+        std::atomic_signal_fence(std::memory_order_seq_cst); // Compiler-only barrier: keeps the pair from being merged.
+        ref->Release();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / iterations;
+}
+
+/// Runs `work(i)` on `num_threads` new threads at once; returns the average of their results.
+template<class TWork>
+static double BenchOnThreads(unsigned num_threads, TWork work)
+{
+    std::atomic<bool> go{false};
+    std::vector<double> results(num_threads);
+    std::vector<std::thread> workers;
+    for (unsigned i = 0; i < num_threads; i++)
+    {
+        workers.emplace_back([&work, &go, &results, i]()
+        {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            results[i] = work(i);
+        });
+    }
+    go.store(true, std::memory_order_release);
+    double total = 0.0;
+    for (unsigned i = 0; i < num_threads; i++)
+    {
+        workers[i].join();
+        total += results[i];
+    }
+    return total / num_threads;
+}
+
+/// Thread counts of the sweep: 1, 2, 4 ... `config.max_threads`.
+static std::vector<unsigned> BenchThreadCounts(const BenchConfig& config)
+{
+    std::vector<unsigned> counts;
+    for (unsigned n = 1; n <= config.max_threads; n *= 2)
+        counts.push_back(n);
+    return counts;
+}
+
+/// One row of the sweep: each thread works on an object of its own, or (`shared`) all use one object
+/// created by this thread - for `RefCountingObjectBiased` that means none of them is the owner.
+template<class TPolicy>
+static void BenchPolicy(const char* name, const BenchConfig& config, bool shared)
+{
+    typedef BenchObject<TPolicy> T;
+    T* shared_obj = T::Create();
+    shared_obj->AddRef();
+
+    std::cout << std::setw(40) << std::left << name << std::right;
+    for (unsigned num_threads: BenchThreadCounts(config))
+    {
+        const double ns = BenchOnThreads(num_threads, [&config, shared, shared_obj](unsigned)
+        {
+            if (shared)
+                return BenchAddRefRelease(shared_obj, config.iterations);
+            T* obj = T::Create();
+            obj->AddRef();
+            const double result = BenchAddRefRelease(obj, config.iterations);
+            obj->Release();
+            return result;
+        });
+        std::cout << std::setw(8) << std::fixed << std::setprecision(2) << ns;
+    }
+    std::cout << std::endl;
+
+    shared_obj->Release();
+}
+
+// Shared global pointer - `AtomicRefCountingObjectPtr` vs `RefCountingObjectPtr` behind a mutex.
+typedef BenchObject<RefCountingObjectMultiThreaded> BenchSharedObject;
+
+/// The obvious alternative to `AtomicRefCountingObjectPtr`.
+class BenchLockedPtr
+{
+public:
+    RefCountingObjectPtr<BenchSharedObject> load() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_ptr;
+    }
+
+    void store(RefCountingObjectPtr<BenchSharedObject> desired)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_ptr.swap(desired); // The old one is released by `desired`, after unlocking.
+    }
+
+private:
+    mutable std::mutex m_mutex;
+    RefCountingObjectPtr<BenchSharedObject> m_ptr;
+};
+
+/// One row of the sweep: ns per `load()` or `store()`. All threads read, or (`with_writer`) thread 0 keeps storing
+/// one of two objects while the others read.
+template<class TShared>
+static void BenchSharedPtr(const char* name, const BenchConfig& config, bool with_writer)
+{
+    const int iterations = std::max(config.iterations / 10, 1); // Contended - much slower than the policy sweep.
+    RefCountingObjectPtr<BenchSharedObject> objs[2] = { BenchSharedObject::Create(), BenchSharedObject::Create() };
+    TShared shared;
+    shared.store(objs[0]);
+
+    std::cout << std::setw(40) << std::left << name << std::right;
+    for (unsigned num_threads: BenchThreadCounts(config))
+    {
+        const double ns = BenchOnThreads(num_threads, [&shared, &objs, iterations, with_writer](unsigned thread)
+        {
+            const auto start = std::chrono::steady_clock::now();
+            if (with_writer && thread == 0)
+            {
+                for (int i = 0; i < iterations; i++)
+                    shared.store(objs[i & 1]);
+            }
+            else
+            {
+                for (int i = 0; i < iterations; i++)
+                    shared.load();
+            }
+            const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+            return elapsed.count() / iterations;
+        });
+        std::cout << std::setw(8) << std::fixed << std::setprecision(2) << ns;
+    }
+    std::cout << std::endl;
+    shared.store(nullptr);
+}
+
+// Vector operations with many duplicate pointers - element by element vs `RefCountingObjectPtrVector*()`.
+
+/// One row: ns per element of copy, clear and fill of a vector of pointers to a few objects.
+template<class TPolicy>
+static void BenchVectorOps(const char* name, const BenchConfig& config, bool batched)
+{
+    typedef BenchObject<TPolicy> T;
+    typedef RefCountingObjectPtr<T> TPtr;
+    const int VECTOR_SIZE = 10000;
+    const int DISTINCT_OBJECTS = 4;
+    const int rounds = std::max(config.iterations / (VECTOR_SIZE * 10), 1);
+
+    std::vector<TPtr> objs;
+    for (int i = 0; i < DISTINCT_OBJECTS; i++)
+        objs.push_back(T::Create());
+    std::vector<TPtr> src;
+    for (int i = 0; i < VECTOR_SIZE; i++)
+        src.push_back(objs[i % DISTINCT_OBJECTS]);
+    std::vector<TPtr> dst;
+    dst.reserve(VECTOR_SIZE);
+
+    std::chrono::duration<double, std::nano> copy_time(0), clear_time(0), fill_time(0);
+    for (int r = 0; r < rounds; r++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        if (batched)
+            RefCountingObjectPtrVectorCopy(dst, src);
+        else
+            dst = src;
+        copy_time += std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        if (batched)
+            RefCountingObjectPtrVectorClear(dst);
+        else
+            dst.clear();
+        clear_time += std::chrono::steady_clock::now() - start;
+
+        start = std::chrono::steady_clock::now();
+        if (batched)
+            RefCountingObjectPtrVectorFill(dst, VECTOR_SIZE, objs[0]);
+        else
+            dst.assign(VECTOR_SIZE, objs[0]);
+        fill_time += std::chrono::steady_clock::now() - start;
+
+        if (batched)
+            RefCountingObjectPtrVectorClear(dst);
+        else
+            dst.clear();
+    }
+
+    const double elements = (double)rounds * VECTOR_SIZE;
+    std::cout << std::setw(40) << std::left << name << std::right << std::fixed << std::setprecision(2)
+        << std::setw(8) << copy_time.count() / elements << std::setw(8) << clear_time.count() / elements
+        << std::setw(8) << fill_time.count() / elements << std::endl;
+}
+
+// Destructor - the default (virtual) vs `virtual_destructor = false`, which is `BenchObject<>`.
+class BenchVirtualObject: public RefCountingObject<BenchVirtualObject> {}; // Not final, like most classes which keep the default.
+
+/// Nanoseconds per last `Release()`, which destroys the object; the allocations aren't timed.
+template<class T>
+static double BenchLastRelease(const BenchConfig& config)
+{
+    const int BATCH = 10000;
+    const int rounds = std::max(config.iterations / BATCH, 1);
+    std::vector<T*> objs(BATCH);
+    std::chrono::duration<double, std::nano> elapsed(0);
+    for (int r = 0; r < rounds; r++)
+    {
+        for (T*& obj: objs)
+        {
+            obj = T::Create();
+            obj->AddRef();
+        }
+        const auto start = std::chrono::steady_clock::now();
+        for (T* obj: objs)
+            obj->Release();
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+    return elapsed.count() / ((double)rounds * BATCH);
+}
+
+template<class T>
+static void BenchDestructor(const char* name, const BenchConfig& config)
+{
+    std::cout << std::setw(40) << std::left << name << std::right << std::setw(8) << sizeof(T) << " bytes"
+        << std::fixed << std::setprecision(2) << std::setw(10) << BenchLastRelease<T>(config) << " ns" << std::endl;
+}
+
+// Smart pointer copies vs moves - counts the refcount operations as well as the time.
+class BenchCountedObject;
+template<> struct RefCountingObjectTraits<BenchCountedObject>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+};
+
+static uint64_t g_bench_refcount_ops = 0;
+
+class BenchCountedObject final: public RefCountingObject<BenchCountedObject>
+{
+public:
+    void AddRef() { g_bench_refcount_ops++; RefCountingObject::AddRef(); } // Hide the base, `RefCountingObjectPtr` calls these.
+    void Release() { g_bench_refcount_ops++; RefCountingObject::Release(); }
+    void AddRef(int n) { g_bench_refcount_ops++; RefCountingObject::AddRef(n); } // `RefCountingObjectBatch`
+    void Release(int n) { g_bench_refcount_ops++; RefCountingObject::Release(n); }
+
+    void Touch() { touched++; } //!< For script benchmarks - a call which does nothing else.
+    int touched = 0;
+};
+
+/// Baseline: `RefCountingObjectPtr` without move semantics - the user-declared copy functions suppress the implicit moves.
+template<class T>
+class BenchCopyOnlyPtr: public RefCountingObjectPtr<T>
+{
+public:
+    BenchCopyOnlyPtr(T* ref): RefCountingObjectPtr<T>(ref) {}
+    BenchCopyOnlyPtr(const BenchCopyOnlyPtr& other): RefCountingObjectPtr<T>(other) {}
+    BenchCopyOnlyPtr& operator=(const BenchCopyOnlyPtr& other) { RefCountingObjectPtr<T>::operator=(other); return *this; }
+};
+
+template<class TPtr> static TPtr BenchPassThrough(TPtr ptr) { return ptr; } // Like `ExampleCppFunctionCall()` in Example.cpp
+
+/// Prints ns and refcount operations per element of a growing `std::vector`, and per call chain.
+template<class TPtr>
+static void BenchPtrTraffic(const char* name, const BenchConfig& config)
+{
+    const int VECTOR_SIZE = 1000; // No `reserve()` - reallocations copy or move all elements.
+    const int rounds = std::max(config.iterations / VECTOR_SIZE, 1);
+    TPtr ptr(BenchCountedObject::Create());
+
+    g_bench_refcount_ops = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        std::vector<TPtr> vec;
+        for (int i = 0; i < VECTOR_SIZE; i++)
+            vec.push_back(ptr);
+    }
+    const std::chrono::duration<double, std::nano> vector_time = std::chrono::steady_clock::now() - start;
+    const double vector_ops = (double)g_bench_refcount_ops / ((double)rounds * VECTOR_SIZE);
+
+    g_bench_refcount_ops = 0;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.iterations; i++)
+        ptr = BenchPassThrough(BenchPassThrough(BenchPassThrough(ptr)));
+    const std::chrono::duration<double, std::nano> chain_time = std::chrono::steady_clock::now() - start;
+    const double chain_ops = (double)g_bench_refcount_ops / config.iterations;
+
+    std::cout << std::setw(40) << std::left << name << std::right << std::fixed << std::setprecision(2)
+        << std::setw(8) << vector_time.count() / ((double)rounds * VECTOR_SIZE) << " ns" << std::setw(8) << vector_ops << " ops"
+        << std::setw(10) << chain_time.count() / config.iterations << " ns" << std::setw(8) << chain_ops << " ops" << std::endl;
+}
+
+// Registries keyed by objects - `RefCountingObjectPtrMap` vs `std::unordered_map` with the `std::hash<>` of the smart pointer.
+typedef RefCountingObjectPtr<BenchCountedObject> BenchCountedPtr;
+
+struct BenchFlatRegistry
+{
+    void Insert(const BenchCountedPtr& key, int value) { map.Insert(key, value); }
+    int* Find(const BenchCountedPtr& key) { return map.Find(key.operator->()); }
+    void Erase(const BenchCountedPtr& key) { map.Erase(key.operator->()); }
+
+    RefCountingObjectPtrMap<BenchCountedObject, int> map;
+};
+
+struct BenchStdRegistry
+{
+    void Insert(const BenchCountedPtr& key, int value) { map.emplace(key, value); }
+    int* Find(const BenchCountedPtr& key) { auto itor = map.find(key); return (itor != map.end()) ? &itor->second : nullptr; }
+    void Erase(const BenchCountedPtr& key) { map.erase(key); }
+
+    std::unordered_map<BenchCountedPtr, int> map;
+};
+
+/// Prints ns and refcount operations per insert, lookup and erase; the map grows from empty to 10000 keys (no `Reserve()`).
+template<class TRegistry>
+static void BenchRegistry(const char* name, const BenchConfig& config)
+{
+    const int KEYS = 10000;
+    const int rounds = std::max(config.iterations / (KEYS * 10), 1);
+
+    std::vector<BenchCountedPtr> keys;
+    for (int i = 0; i < KEYS; i++)
+        keys.push_back(BenchCountedObject::Create());
+
+    std::chrono::duration<double, std::nano> insert_time(0), find_time(0), erase_time(0);
+    uint64_t insert_ops = 0, find_ops = 0, erase_ops = 0;
+    int found = 0;
+    for (int r = 0; r < rounds; r++)
+    {
+        TRegistry registry;
+
+        g_bench_refcount_ops = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < KEYS; i++)
+            registry.Insert(keys[i], i);
+        insert_time += std::chrono::steady_clock::now() - start;
+        insert_ops += g_bench_refcount_ops;
+
+        g_bench_refcount_ops = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = KEYS - 1; i >= 0; i--) // Not in insertion order.
+            found += (registry.Find(keys[i]) != nullptr) ? 1 : 0;
+        find_time += std::chrono::steady_clock::now() - start;
+        find_ops += g_bench_refcount_ops;
+
+        g_bench_refcount_ops = 0;
+        start = std::chrono::steady_clock::now();
+        for (int i = 0; i < KEYS; i++)
+            registry.Erase(keys[i]);
+        erase_time += std::chrono::steady_clock::now() - start;
+        erase_ops += g_bench_refcount_ops;
+    }
+    assert(found == rounds * KEYS);
+
+    const double count = (double)rounds * KEYS;
+    std::cout << std::setw(40) << std::left << name << std::right << std::fixed << std::setprecision(2)
+        << std::setw(8) << insert_time.count() / count << " ns" << std::setw(6) << insert_ops / count << " ops"
+        << std::setw(8) << find_time.count() / count << " ns" << std::setw(6) << find_ops / count << " ops"
+        << std::setw(8) << erase_time.count() / count << " ns" << std::setw(6) << erase_ops / count << " ops" << std::endl;
+}
+
+// Allocation churn - the same object allocated with global new/delete and from the slab pool.
+class BenchPlainObject;
+class BenchPooledObject;
+template<> struct RefCountingObjectTraits<BenchPlainObject>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+};
+template<> struct RefCountingObjectTraits<BenchPooledObject>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+};
+
+class BenchPlainObject final: public RefCountingObject<BenchPlainObject>
+{
+    char m_payload[48];
+};
+
+class BenchPooledObject final: public RefCountingObject<BenchPooledObject>, public RefCountingObjectPooled<BenchPooledObject>
+{
+    char m_payload[48];
+};
+
+/// ns per `Create()`+`Release()`, replacing objects at random in a set of live ones (so frees don't come in allocation order).
+template<class T>
+static double BenchChurn(const BenchConfig& config)
+{
+    const size_t LIVE_OBJECTS = 10000;
+    std::vector<T*> live(LIVE_OBJECTS);
+    for (T*& obj: live)
+    {
+        obj = T::Create();
+        obj->AddRef();
+    }
+
+    uint32_t rng = 12345;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.iterations; i++)
+    {
+        rng = rng * 1664525u + 1013904223u; // LCG - cheap, and the same sequence for both allocators.
+        T*& slot = live[(rng >> 8) % LIVE_OBJECTS];
+        slot->Release();
+        slot = T::Create();
+        slot->AddRef();
+    }
+    const std::chrono::duration<double, std::nano> elapsed = std::chrono::steady_clock::now() - start;
+
+    for (T* obj: live)
+        obj->Release();
+    return elapsed.count() / config.iterations;
+}
+
+/// Short callbacks - the case the pool is for: the call itself is cheap, so context setup dominates.
+// Script benchmarks - `BenchCountedObject` registered as "BenchObject", with handle type "BenchObjectPtr".
+class BenchAcyclicObject;
+template<> struct RefCountingObjectTraits<BenchAcyclicObject>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+    static constexpr bool acyclic = true;
+};
+
+class BenchAcyclicObject final: public RefCountingObject<BenchAcyclicObject> {}; // "BenchAcyclic", handle type "BenchAcyclicPtr"
+
+static std::vector<asIScriptObject*> g_bench_kept; // Script objects kept alive from C++, see `BenchGarbageCollector()`.
+
+static BenchCountedObject* BenchObjectFactory() { return BenchCountedObject::Create(); } // Registered as `@+`
+static BenchAcyclicObject* BenchAcyclicFactory() { return BenchAcyclicObject::Create(); } // Registered as `@+`
+static void BenchTakePtr(RefCountingObjectPtr<BenchCountedObject> ptr) { ptr->Touch(); } // Like `PutToStable()` in Example.cpp
+static void BenchTakeRef(RefCountingObjectRef<BenchCountedObject> ref) { ref->Touch(); } // Like `IsInStable()`
+
+static void BenchKeep(void* ref, int type_id) // Registered as "void Keep(?&in)"
+{
+    asIScriptObject* obj = static_cast<asIScriptObject*>((type_id & asTYPEID_OBJHANDLE) ? *static_cast<void**>(ref) : ref);
+    if (obj)
+    {
+        obj->AddRef();
+        g_bench_kept.push_back(obj);
+    }
+}
+
+/// Engine with the bench types registered; nullptr (and FAILED printed) if the engine can't be created.
+static asIScriptEngine* BenchCreateEngine()
+{
+    asIScriptEngine* engine = asCreateScriptEngine();
+    if (!engine)
+    {
+        std::cout << "FAILED: couldn't create the script engine." << std::endl;
+        return nullptr;
+    }
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+
+    int r;
+    BenchCountedObject::RegisterRefCountingObject(engine, "BenchObject");
+    r = engine->RegisterObjectBehaviour("BenchObject", asBEHAVE_FACTORY, "BenchObject@+ f()", asFUNCTION(BenchObjectFactory), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterObjectMethod("BenchObject", "void Touch()", asMETHOD(BenchCountedObject, Touch), asCALL_THISCALL); assert( r >= 0 );
+    RefCountingObjectPtr<BenchCountedObject>::RegisterRefCountingObjectPtr(engine, "BenchObjectPtr", "BenchObject");
+    RefCountingObjectRef<BenchCountedObject>::RegisterRefCountingObjectRef(engine, "BenchObjectRef", "BenchObject", "BenchObjectPtr");
+    r = engine->RegisterGlobalFunction("void TakePtr(BenchObjectPtr@ p)", asFUNCTION(BenchTakePtr), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterGlobalFunction("void TakeRef(BenchObjectRef@ r)", asFUNCTION(BenchTakeRef), asCALL_CDECL); assert( r >= 0 );
+
+    BenchAcyclicObject::RegisterRefCountingObject(engine, "BenchAcyclic");
+    r = engine->RegisterObjectBehaviour("BenchAcyclic", asBEHAVE_FACTORY, "BenchAcyclic@+ f()", asFUNCTION(BenchAcyclicFactory), asCALL_CDECL); assert( r >= 0 );
+    RefCountingObjectPtr<BenchAcyclicObject>::RegisterRefCountingObjectPtr(engine, "BenchAcyclicPtr", "BenchAcyclic");
+    r = engine->RegisterGlobalFunction("void Keep(?&in)", asFUNCTION(BenchKeep), asCALL_CDECL); assert( r >= 0 );
+
+    RefCountingObjectPtrArray<BenchCountedObject>::RegisterRefCountingObjectPtrArray(engine, "BenchObjectPtrArray", "BenchObject", "BenchObjectPtr");
+#if defined(RCO_BENCH_SCRIPTARRAY)
+    RegisterScriptArray(engine, true);
+#endif
+    return engine;
+}
+
+/// Builds `script` as module "bench"; nullptr (and FAILED printed) on error.
+static asIScriptModule* BenchBuildScript(asIScriptEngine* engine, const char* script)
+{
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    int r = mod->AddScriptSection("bench", script);
+    if (r >= 0)
+        r = mod->Build();
+    if (r < 0)
+    {
+        std::cout << "FAILED: couldn't build the benchmark script." << std::endl;
+        return nullptr;
+    }
+    return mod;
+}
+
+/// Seconds to run script function `decl` (taking one `int`) once with `count`, or -1 on error.
+static double BenchRunScript(asIScriptEngine* engine, asIScriptModule* mod, const char* decl, int count)
+{
+    asIScriptFunction* func = mod->GetFunctionByDecl(decl);
+    if (!func)
+        return -1;
+    asIScriptContext* ctx = engine->CreateContext();
+    ctx->Prepare(func);
+    ctx->SetArgDWord(0, (asDWORD)count);
+    const auto start = std::chrono::steady_clock::now();
+    const int r = ctx->Execute();
+    const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    ctx->Release();
+    return (r == asEXECUTION_FINISHED) ? elapsed.count() : -1;
+}
+
+/// Builds `script` with the bench types and runs each `{ decl, label }` function `void f(int)` with `count`,
+/// printing calls/s (or other `unit`) and refcount operations per call. Returns false if any of it failed.
+template<size_t N>
+static bool BenchScriptCalls(const char* script, const char* (&funcs)[N][2], int count, const char* unit = "calls/s")
+{
+    asIScriptEngine* engine = BenchCreateEngine();
+    if (!engine)
+        return false;
+    asIScriptModule* mod = BenchBuildScript(engine, script);
+    if (!mod)
+    {
+        engine->ShutDownAndRelease();
+        return false;
+    }
+
+    bool ok = true;
+    for (auto& func: funcs)
+    {
+        g_bench_refcount_ops = 0;
+        const double seconds = BenchRunScript(engine, mod, func[0], count);
+        if (seconds < 0)
+        {
+            std::cout << "FAILED: " << func[0] << " didn't run." << std::endl;
+            ok = false;
+            continue;
+        }
+        std::cout << std::setw(40) << std::left << func[1] << std::right << std::setw(12) << (uint64_t)(count / seconds) << " " << unit
+            << std::fixed << std::setprecision(2) << std::setw(8) << (double)g_bench_refcount_ops / count << " ops" << std::endl;
+    }
+
+    engine->ShutDownAndRelease();
+    return ok;
+}
+
+/// `RefCountingObjectPtrArray` vs `array<>` of the handle type: inserting, and copying whole arrays (per element).
+static bool BenchArrays(const BenchConfig& config)
+{
+    const int count = std::max(config.callbacks / 1000, 1) * 1000; // Copies are of 1000 elements.
+    const char* script =
+        "BenchObject@ g_obj = BenchObject();                                                   \n"
+        "BenchObjectPtr g_ptr = g_obj;                                                         \n"
+        "void PtrArrayInsert(int n) { BenchObjectPtrArray a; for (int i = 0; i < n; i++) a.insertLast(g_obj); } \n"
+        "void PtrArrayCopy(int n)                                                              \n"
+        "{                                                                                     \n"
+        "    BenchObjectPtrArray src, dst;                                                     \n"
+        "    for (int i = 0; i < 1000; i++) src.insertLast(g_obj);                             \n"
+        "    for (int i = 0; i < n / 1000; i++) dst = src;                                     \n"
+        "}                                                                                     \n"
+#if defined(RCO_BENCH_SCRIPTARRAY)
+        "void ArrayInsert(int n) { array<BenchObjectPtr> a; for (int i = 0; i < n; i++) a.insertLast(g_ptr); } \n"
+        "void ArrayCopy(int n)                                                                 \n"
+        "{                                                                                     \n"
+        "    array<BenchObjectPtr> src, dst;                                                   \n"
+        "    for (int i = 0; i < 1000; i++) src.insertLast(g_ptr);                             \n"
+        "    for (int i = 0; i < n / 1000; i++) dst = src;                                     \n"
+        "}                                                                                     \n"
+#endif
+        ;
+    const char* funcs[][2] = {
+#if defined(RCO_BENCH_SCRIPTARRAY)
+        { "void ArrayInsert(int)",    "array<BenchObjectPtr> insertLast()" },
+        { "void ArrayCopy(int)",      "array<BenchObjectPtr> copy" },
+#endif
+        { "void PtrArrayInsert(int)", "BenchObjectPtrArray insertLast()" },
+        { "void PtrArrayCopy(int)",   "BenchObjectPtrArray copy" } };
+#if !defined(RCO_BENCH_SCRIPTARRAY)
+    std::cout << "array<> skipped - build with RCO_BENCH_SCRIPTARRAY and the SDK's scriptarray add-on to compare." << std::endl;
+#endif
+    return BenchScriptCalls(script, funcs, count, "elements/s");
+}
+
+/// Handle type -> native handle conversions in a script loop.
+static bool BenchConversions(const BenchConfig& config)
+{
+    const char* script =
+        "BenchObject@ g_obj = BenchObject();                                                   \n"
+        "BenchObjectPtr g_ptr = g_obj;                                                         \n"
+        "void Native(int n)    { for (int i = 0; i < n; i++) g_obj.Touch(); }                  \n"
+        "void ImplCast(int n)  { for (int i = 0; i < n; i++) { BenchObject@ h = g_ptr; h.Touch(); } } \n"
+        "void GetHandle(int n) { for (int i = 0; i < n; i++) g_ptr.GetHandle().Touch(); }      \n"
+        "void Borrow(int n)    { for (int i = 0; i < n; i++) g_ptr.Borrow().Touch(); }         \n";
+    const char* funcs[][2] = {
+        { "void Native(int)",    "native handle (baseline)" },
+        { "void ImplCast(int)",  "opImplCast()" },
+        { "void GetHandle(int)", "GetHandle()" },
+        { "void Borrow(int)",    "Borrow()" } };
+    return BenchScriptCalls(script, funcs, config.callbacks);
+}
+
+/// Application function parameters - counted handle type vs borrowed reference.
+static bool BenchParameters(const BenchConfig& config)
+{
+    const char* script =
+        "BenchObject@ g_obj = BenchObject();                                                   \n"
+        "BenchObjectPtr g_ptr = g_obj;                                                         \n"
+        "void PtrFromPtr(int n)    { for (int i = 0; i < n; i++) TakePtr(g_ptr); }             \n"
+        "void RefFromPtr(int n)    { for (int i = 0; i < n; i++) TakeRef(g_ptr); }             \n"
+        "void PtrFromHandle(int n) { for (int i = 0; i < n; i++) TakePtr(g_obj); }             \n"
+        "void RefFromHandle(int n) { for (int i = 0; i < n; i++) TakeRef(g_obj); }             \n";
+    const char* funcs[][2] = {
+        { "void PtrFromPtr(int)",    "BenchObjectPtr param, from ptr" },
+        { "void RefFromPtr(int)",    "BenchObjectRef param, from ptr" },
+        { "void PtrFromHandle(int)", "BenchObjectPtr param, from handle" },
+        { "void RefFromHandle(int)", "BenchObjectRef param, from handle" } };
+    return BenchScriptCalls(script, funcs, config.callbacks);
+}
+
+/// Full GC cycles with many live script objects which hold handles - to a regular type, and to an `acyclic` one.
+static bool BenchGarbageCollector(const BenchConfig& /*config*/)
+{
+    const int HOLDERS = 100000;
+    const int CYCLES = 10;
+
+    asIScriptEngine* engine = BenchCreateEngine();
+    if (!engine)
+        return false;
+    const char* script =
+        "class Holder { BenchObjectPtr ptr; }                                                  \n"
+        "class AcyclicHolder { BenchAcyclicPtr ptr; }                                          \n"
+        "void MakeHolders(int n)                                                               \n"
+        "{                                                                                     \n"
+        "    BenchObject@ obj = BenchObject();                                                 \n"
+        "    for (int i = 0; i < n; i++) { Holder h; @h.ptr = obj; Keep(h); }                  \n"
+        "}                                                                                     \n"
+        "void MakeAcyclicHolders(int n)                                                        \n"
+        "{                                                                                     \n"
+        "    BenchAcyclic@ obj = BenchAcyclic();                                               \n"
+        "    for (int i = 0; i < n; i++) { AcyclicHolder h; @h.ptr = obj; Keep(h); }           \n"
+        "}                                                                                     \n";
+    asIScriptModule* mod = BenchBuildScript(engine, script);
+    if (!mod)
+    {
+        engine->ShutDownAndRelease();
+        return false;
+    }
+
+    const char* funcs[][2] = {
+        { "void MakeHolders(int)",        "BenchObjectPtr members" },
+        { "void MakeAcyclicHolders(int)", "BenchAcyclicPtr members (acyclic)" } };
+    bool ok = true;
+    for (auto& func: funcs)
+    {
+        if (BenchRunScript(engine, mod, func[0], HOLDERS) < 0)
+        {
+            std::cout << "FAILED: " << func[0] << " didn't run." << std::endl;
+            ok = false;
+            continue;
+        }
+        engine->GarbageCollect(asGC_FULL_CYCLE);
+        asUINT tracked = 0;
+        engine->GetGCStatistics(&tracked);
+
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < CYCLES; i++)
+            engine->GarbageCollect(asGC_FULL_CYCLE);
+        const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+        std::cout << std::setw(40) << std::left << func[1] << std::right << std::fixed << std::setprecision(2)
+            << std::setw(8) << elapsed.count() / CYCLES << " ms" << std::setw(10) << tracked << " objects in GC" << std::endl;
+
+        for (asIScriptObject* obj: g_bench_kept)
+            obj->Release();
+        g_bench_kept.clear();
+        engine->GarbageCollect(asGC_FULL_CYCLE);
+    }
+
+    engine->ShutDownAndRelease();
+    return ok;
+}
+
+// Startup - registering many types, declarations formatted at runtime vs built at compile time.
+static const int BENCH_STARTUP_TYPES = 1000;
+
+template<int N> struct BenchSyntheticName {}; // Only carries the names, see below.
+
+template<int N> struct RefCountingObjectTraits<BenchSyntheticName<N>>: RefCountingObjectDefaultTraits
+{
+    static constexpr char name[] = { 'B', 'e', 'n', 'c', 'h', 'T', char('0' + N / 100 % 10), char('0' + N / 10 % 10), char('0' + N % 10), '\0' };
+    static constexpr char ptr_name[] = { 'B', 'e', 'n', 'c', 'h', 'T', char('0' + N / 100 % 10), char('0' + N / 10 % 10), char('0' + N % 10), 'P', 't', 'r', '\0' };
+};
+template<int N> constexpr char RefCountingObjectTraits<BenchSyntheticName<N>>::name[];
+template<int N> constexpr char RefCountingObjectTraits<BenchSyntheticName<N>>::ptr_name[];
+
+class BenchSyntheticType;
+template<> struct RefCountingObjectTraits<BenchSyntheticType>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+};
+
+// One C++ type registered under all the names - 1000 distinct `RefCountingObject<>` types would take minutes to compile,
+// and the registration calls don't depend on the C++ type anyway. Does what `RegisterRefCountingObjectTypes<>()` does
+// for each type, with the declarations from `RefCountingObjectStaticDecls<>`.
+class BenchSyntheticType final: public RefCountingObject<BenchSyntheticType> {};
+
+template<int... Ns>
+static void BenchRegisterStatic(asIScriptEngine* engine, std::integer_sequence<int, Ns...>)
+{
+    int objs[] = { 0, (BenchSyntheticType::RegisterRefCountingObject(engine, RefCountingObjectTraits<BenchSyntheticName<Ns>>::name), 0)... };
+    int ptrs[] = { 0, (RefCountingObjectPtr<BenchSyntheticType>::RegisterRefCountingObjectPtr(engine, RefCountingObjectStaticDecls<BenchSyntheticName<Ns>>::ptr_decls), 0)... };
+    (void)objs; (void)ptrs;
+}
+
+/// Milliseconds to register `BENCH_STARTUP_TYPES` object + handle types, or -1 if the engine can't be created.
+static double BenchStartup(bool compile_time)
+{
+    asIScriptEngine* engine = asCreateScriptEngine();
+    if (!engine)
+        return -1;
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+
+    const auto start = std::chrono::steady_clock::now();
+    if (compile_time)
+    {
+        BenchRegisterStatic(engine, std::make_integer_sequence<int, BENCH_STARTUP_TYPES>());
+    }
+    else
+    {
+        char name[20], ptr_name[20];
+        for (int i = 0; i < BENCH_STARTUP_TYPES; i++)
+        {
+            snprintf(name, sizeof(name), "BenchT%03d", i);
+            snprintf(ptr_name, sizeof(ptr_name), "BenchT%03dPtr", i);
+            BenchSyntheticType::RegisterRefCountingObject(engine, name);
+            RefCountingObjectPtr<BenchSyntheticType>::RegisterRefCountingObjectPtr(engine, ptr_name, name);
+        }
+    }
+    const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    engine->ShutDownAndRelease();
+    return elapsed.count();
+}
+
+static bool BenchContextPool(const BenchConfig& config)
+{
+    asIScriptEngine* engine = asCreateScriptEngine();
+    if (!engine)
+    {
+        std::cout << "FAILED: couldn't create the script engine." << std::endl;
+        return false;
+    }
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    ContextPoolInstall(engine);
+
+    const char* script = "int counter = 0; void Callback() { counter++; }";
+    asIScriptModule* mod = engine->GetModule("bench", asGM_ALWAYS_CREATE);
+    int r = mod->AddScriptSection("bench", script);
+    if (r >= 0)
+        r = mod->Build();
+    asIScriptFunction* func = (r >= 0) ? mod->GetFunctionByDecl("void Callback()") : nullptr;
+    if (!func)
+    {
+        std::cout << "FAILED: couldn't build the callback script." << std::endl;
+        engine->ShutDownAndRelease();
+        return false;
+    }
+
+    // A new context per call
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.callbacks; i++)
+    {
+        asIScriptContext* ctx = engine->CreateContext();
+        ctx->Prepare(func);
+        ctx->Execute();
+        ctx->Release();
+    }
+    const std::chrono::duration<double> unpooled = std::chrono::steady_clock::now() - start;
+
+    // Pooled
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < config.callbacks; i++)
+    {
+        asIScriptContext* ctx = ContextPoolAcquire(engine, func);
+        ctx->Execute();
+        ContextPoolRelease(ctx);
+    }
+    const std::chrono::duration<double> pooled = std::chrono::steady_clock::now() - start;
+
+    const int* counter = static_cast<int*>(mod->GetAddressOfGlobalVar(0));
+    std::cout << "CreateContext() per call: " << (uint64_t)(config.callbacks / unpooled.count()) << " callbacks/s" << std::endl;
+    std::cout << "ContextPoolAcquire(): " << (uint64_t)(config.callbacks / pooled.count()) << " callbacks/s, "
+        << unpooled.count() / pooled.count() << "x" << std::endl;
+    const bool ok = counter && *counter == 2 * config.callbacks;
+    if (!ok)
+        std::cout << "FAILED: the callback didn't run " << 2 * config.callbacks << " times." << std::endl;
+
+    ContextPoolClearThread();
+    engine->ShutDownAndRelease();
+    return ok;
+}
+
+int RunBenchmarks(const BenchConfig& config)
+{
+    int failed = 0;
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Refcount policies (ns per AddRef+Release pair) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    std::cout << std::setw(40) << std::left << "threads:" << std::right;
+    for (unsigned num_threads: BenchThreadCounts(config))
+        std::cout << std::setw(8) << num_threads;
+    std::cout << std::endl;
+    BenchPolicy<RefCountingObjectSingleThreaded>("SingleThreaded, own object", config, false);
+    BenchPolicy<RefCountingObjectMultiThreaded>("MultiThreaded, own object", config, false);
+    BenchPolicy<RefCountingObjectMultiThreaded>("MultiThreaded, one shared object", config, true);
+    BenchPolicy<RefCountingObjectBiased>("Biased, own object", config, false);
+    BenchPolicy<RefCountingObjectBiased>("Biased, one shared object", config, true);
+    RefCountingObjectBiased::ProcessQueue();
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Shared global pointer (ns per load/store) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    std::cout << std::setw(40) << std::left << "threads:" << std::right;
+    for (unsigned num_threads: BenchThreadCounts(config))
+        std::cout << std::setw(8) << num_threads;
+    std::cout << std::endl;
+    BenchSharedPtr<AtomicRefCountingObjectPtr<BenchSharedObject>>("AtomicRefCountingObjectPtr, readers", config, false);
+    BenchSharedPtr<AtomicRefCountingObjectPtr<BenchSharedObject>>("AtomicRefCountingObjectPtr, 1 writer", config, true);
+    BenchSharedPtr<BenchLockedPtr>("RefCountingObjectPtr + mutex, readers", config, false);
+    BenchSharedPtr<BenchLockedPtr>("RefCountingObjectPtr + mutex, 1 writer", config, true);
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Vector of 10000 pointers to 4 objects (ns per element) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    std::cout << std::setw(40) << std::left << "" << std::right << std::setw(8) << "copy" << std::setw(8) << "clear" << std::setw(8) << "fill" << std::endl;
+    BenchVectorOps<RefCountingObjectSingleThreaded>("SingleThreaded, element by element", config, false);
+    BenchVectorOps<RefCountingObjectSingleThreaded>("SingleThreaded, batched", config, true);
+    BenchVectorOps<RefCountingObjectMultiThreaded>("MultiThreaded, element by element", config, false);
+    BenchVectorOps<RefCountingObjectMultiThreaded>("MultiThreaded, batched", config, true);
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Destructor (sizeof, ns per last Release) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    BenchDestructor<BenchVirtualObject>("virtual_destructor = true (default)", config);
+    BenchDestructor<BenchObject<RefCountingObjectSingleThreaded>>("virtual_destructor = false", config);
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Smart pointer copies vs moves (per element / per call chain) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    std::cout << std::setw(40) << std::left << "" << std::right << std::setw(22) << "vector growth" << std::setw(26) << "3 nested calls" << std::endl;
+    BenchPtrTraffic<BenchCopyOnlyPtr<BenchCountedObject>>("copy only (no move semantics)", config);
+    BenchPtrTraffic<RefCountingObjectPtr<BenchCountedObject>>("RefCountingObjectPtr (move)", config);
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Registry of 10000 objects (per insert / lookup / erase) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    std::cout << std::setw(40) << std::left << "" << std::right << std::setw(21) << "insert" << std::setw(21) << "lookup" << std::setw(21) << "erase" << std::endl;
+    BenchRegistry<BenchFlatRegistry>("RefCountingObjectPtrMap", config);
+    BenchRegistry<BenchStdRegistry>("std::unordered_map<RefCountingObjectPtr>", config);
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Allocation churn (ns per Create+Release, 10000 live objects) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    std::cout << std::setw(40) << std::left << "global new/delete" << std::right << std::setw(8) << BenchChurn<BenchPlainObject>(config) << std::endl;
+    std::cout << std::setw(40) << std::left << "RefCountingObjectPooled" << std::right << std::setw(8) << BenchChurn<BenchPooledObject>(config)
+        << " (" << BenchPooledObject::GetPoolStats().slabs << " slabs)" << std::endl;
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Handle conversions in script (refcount operations per call) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    failed += BenchConversions(config) ? 0 : 1;
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Parameters in script calls, counted vs borrowed (refcount operations per call) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    failed += BenchParameters(config) ? 0 : 1;
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Script arrays of handles (refcount operations per element) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    failed += BenchArrays(config) ? 0 : 1;
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Garbage collector (ms per full cycle, 100000 script objects holding handles) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    failed += BenchGarbageCollector(config) ? 0 : 1;
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Startup (ms to register " << BENCH_STARTUP_TYPES << " object and handle types) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    const double runtime_ms = BenchStartup(false);
+    const double static_ms = BenchStartup(true);
+    if (runtime_ms < 0 || static_ms < 0)
+    {
+        std::cout << "FAILED: couldn't create the script engine." << std::endl;
+        failed++;
+    }
+    else
+    {
+        std::cout << std::setw(40) << std::left << "declarations formatted at runtime" << std::right << std::setw(8) << runtime_ms << std::endl;
+        std::cout << std::setw(40) << std::left << "RegisterRefCountingObjectTypes<>()" << std::right << std::setw(8) << static_ms << std::endl;
+    }
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Context pool (trivial script callback) ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    failed += BenchContextPool(config) ? 0 : 1;
+
+    return (failed == 0) ? 0 : -1;
+}
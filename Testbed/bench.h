@@ -0,0 +1,16 @@
+#pragma once
+
+// Timing runs - a quick look at what the RefCountingObject features cost on this machine; not a rigorous benchmark.
+// Build in Release and run as `Testbed --bench [iterations] [callbacks]`.
+// To compare script arrays with the SDK's `array<>`, define RCO_BENCH_SCRIPTARRAY and add the scriptarray add-on
+// (include path and scriptarray.cpp) to the project.
+
+struct BenchConfig
+{
+    int iterations = 10000000;  //!< AddRef+Release pairs per thread and policy.
+    unsigned max_threads = 16;  //!< Thread sweep 1, 2, 4 ... `max_threads`.
+    int callbacks = 1000000;    //!< Script calls (or loop iterations) per script benchmark.
+};
+
+/// Prints the results; returns 0, or -1 if a run failed its own checks.
+int RunBenchmarks(const BenchConfig& config);
@@ -0,0 +1,193 @@
+#include "bytecode_cache.h"
+
+#include <cstdio>
+#include <cstring>
+
+// File layout: header, then the bytecode as written by `asIScriptModule::SaveByteCode()`.
+static const char BYTECODE_CACHE_MAGIC[4] = { 'R', 'C', 'O', 'B' };
+static const uint32_t BYTECODE_CACHE_VERSION = 1;
+
+/// FNV-1a, 64 bit.
+struct BytecodeCacheHasher
+{
+    uint64_t hash = 14695981039346656037ull;
+
+    void Add(const void* data, size_t size)
+    {
+        const unsigned char* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+    }
+
+    void AddString(const char* str)
+    {
+        if (!str)
+            str = "";
+        this->Add(str, strlen(str) + 1); // Including the terminator, so that "ab"+"c" != "a"+"bc".
+    }
+
+    void AddValue(uint64_t value) { this->Add(&value, sizeof(value)); }
+
+    void AddFunction(asIScriptFunction* func)
+    {
+        this->AddString((func) ? func->GetDeclaration(true, true, true) : nullptr);
+    }
+};
+
+class BytecodeCacheFileStream: public asIBinaryStream
+{
+public:
+    explicit BytecodeCacheFileStream(FILE* file): m_file(file) {}
+
+    int Read(void* ptr, asUINT size) override { return (fread(ptr, 1, size, m_file) == size) ? 0 : -1; }
+    int Write(const void* ptr, asUINT size) override { return (fwrite(ptr, 1, size, m_file) == size) ? 0 : -1; }
+
+private:
+    FILE* m_file;
+};
+
+static void BytecodeCacheHashTypeInfo(BytecodeCacheHasher& h, asITypeInfo* type)
+{
+    h.AddString(type->GetNamespace());
+    h.AddString(type->GetName());
+    h.AddValue(type->GetFlags());
+    h.AddValue(type->GetSize());
+    for (asUINT i = 0; i < type->GetFactoryCount(); i++)
+        h.AddFunction(type->GetFactoryByIndex(i));
+    for (asUINT i = 0; i < type->GetBehaviourCount(); i++)
+    {
+        asEBehaviours beh = asBEHAVE_CONSTRUCT;
+        h.AddFunction(type->GetBehaviourByIndex(i, &beh));
+        h.AddValue(beh);
+    }
+    for (asUINT i = 0; i < type->GetMethodCount(); i++)
+        h.AddFunction(type->GetMethodByIndex(i));
+    for (asUINT i = 0; i < type->GetPropertyCount(); i++)
+        h.AddString(type->GetPropertyDeclaration(i, true));
+}
+
+uint64_t BytecodeCacheFingerprintInterface(asIScriptEngine* engine)
+{
+    BytecodeCacheHasher h;
+    h.AddString(asGetLibraryVersion());
+    h.AddString(asGetLibraryOptions());
+    h.AddValue(sizeof(void*));
+    for (int prop = 1; prop < asEP_LAST_PROPERTY; prop++)
+        h.AddValue((uint64_t)engine->GetEngineProperty((asEEngineProp)prop));
+
+    // Object types - this covers the `RefCountingObjectPtr` handle types too, incl. `asOBJ_GC` and size.
+    for (asUINT i = 0; i < engine->GetObjectTypeCount(); i++)
+        BytecodeCacheHashTypeInfo(h, engine->GetObjectTypeByIndex(i));
+
+    for (asUINT i = 0; i < engine->GetEnumCount(); i++)
+    {
+        asITypeInfo* type = engine->GetEnumByIndex(i);
+        h.AddString(type->GetNamespace());
+        h.AddString(type->GetName());
+        for (asUINT v = 0; v < type->GetEnumValueCount(); v++)
+        {
+            int value = 0;
+            h.AddString(type->GetEnumValueByIndex(v, &value));
+            h.AddValue((uint64_t)value);
+        }
+    }
+
+    for (asUINT i = 0; i < engine->GetFuncdefCount(); i++)
+        h.AddFunction(engine->GetFuncdefByIndex(i)->GetFuncdefSignature());
+
+    for (asUINT i = 0; i < engine->GetTypedefCount(); i++)
+    {
+        asITypeInfo* type = engine->GetTypedefByIndex(i);
+        h.AddString(type->GetNamespace());
+        h.AddString(type->GetName());
+        h.AddString(engine->GetTypeDeclaration(type->GetTypedefTypeId(), true));
+    }
+
+    for (asUINT i = 0; i < engine->GetGlobalFunctionCount(); i++)
+        h.AddFunction(engine->GetGlobalFunctionByIndex(i));
+
+    for (asUINT i = 0; i < engine->GetGlobalPropertyCount(); i++)
+    {
+        const char* name = nullptr;
+        const char* ns = nullptr;
+        int type_id = 0;
+        bool is_const = false;
+        engine->GetGlobalPropertyByIndex(i, &name, &ns, &type_id, &is_const);
+        h.AddString(ns);
+        h.AddString(name);
+        h.AddString(engine->GetTypeDeclaration(type_id, true));
+        h.AddValue(is_const);
+    }
+
+    return h.hash;
+}
+
+static bool BytecodeCacheLoad(asIScriptModule* mod, const char* cache_file, uint64_t key)
+{
+    FILE* f = nullptr;
+    fopen_s(&f, cache_file, "rb");
+    if (!f)
+        return false;
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    uint64_t file_key = 0;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1
+        && memcmp(magic, BYTECODE_CACHE_MAGIC, sizeof(magic)) == 0
+        && fread(&version, sizeof(version), 1, f) == 1
+        && version == BYTECODE_CACHE_VERSION
+        && fread(&file_key, sizeof(file_key), 1, f) == 1
+        && file_key == key;
+    if (ok)
+    {
+        BytecodeCacheFileStream stream(f);
+        ok = mod->LoadByteCode(&stream) >= 0; // On failure the module is left empty - the build below starts over.
+    }
+    fclose(f);
+    return ok;
+}
+
+static void BytecodeCacheSave(asIScriptModule* mod, const char* cache_file, uint64_t key)
+{
+    // Write to a temporary file first, so that an interrupted write never leaves a truncated cache.
+    const std::string tmp_file = std::string(cache_file) + ".tmp";
+    FILE* f = nullptr;
+    fopen_s(&f, tmp_file.c_str(), "wb");
+    if (!f)
+        return;
+
+    BytecodeCacheFileStream stream(f);
+    bool ok = fwrite(BYTECODE_CACHE_MAGIC, sizeof(BYTECODE_CACHE_MAGIC), 1, f) == 1
+        && fwrite(&BYTECODE_CACHE_VERSION, sizeof(BYTECODE_CACHE_VERSION), 1, f) == 1
+        && fwrite(&key, sizeof(key), 1, f) == 1
+        && mod->SaveByteCode(&stream) >= 0; // With debug info, so that exceptions still report lines.
+    ok = (fclose(f) == 0) && ok;
+
+    if (ok)
+    {
+        remove(cache_file); // `rename()` doesn't overwrite on Windows.
+        ok = rename(tmp_file.c_str(), cache_file) == 0;
+    }
+    if (!ok)
+        remove(tmp_file.c_str());
+}
+
+BytecodeCacheResult BytecodeCacheBuildModule(asIScriptModule* mod, const char* section_name, const std::string& source, const char* cache_file)
+{
+    BytecodeCacheHasher h;
+    h.AddValue(BytecodeCacheFingerprintInterface(mod->GetEngine()));
+    h.AddString(section_name);
+    h.Add(source.data(), source.size());
+
+    if (BytecodeCacheLoad(mod, cache_file, h.hash))
+        return BYTECODE_CACHE_LOADED;
+
+    if (mod->AddScriptSection(section_name, source.data(), source.size()) < 0 || mod->Build() < 0)
+        return BYTECODE_CACHE_FAILED;
+
+    BytecodeCacheSave(mod, cache_file, h.hash);
+    return BYTECODE_CACHE_BUILT;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+// Bytecode cache - saves a module's bytecode after a build and loads it on later starts instead of compiling.
+// The cache file is keyed by a hash of the script source and a fingerprint of the engine's registered
+// interface (object types incl. all `RegisterRefCountingObjectPtr()` handle types with their flags and sizes,
+// methods, behaviours, globals, enums, funcdefs, engine properties and library version).
+// Any mismatch - or a failed load - falls back to a normal build, which rewrites the cache.
+
+#include <angelscript.h>
+#include <cstdint>
+#include <string>
+
+enum BytecodeCacheResult
+{
+    BYTECODE_CACHE_LOADED,  //!< Warm start - bytecode loaded, no compilation.
+    BYTECODE_CACHE_BUILT,   //!< Cold start - compiled and the cache was (re)written.
+    BYTECODE_CACHE_FAILED,  //!< The script failed to build.
+};
+
+/// Changes whenever anything that affects compiled bytecode is registered differently.
+uint64_t BytecodeCacheFingerprintInterface(asIScriptEngine* engine);
+
+/// Builds `mod` from `source` (a single script section) unless `cache_file` holds matching bytecode.
+BytecodeCacheResult BytecodeCacheBuildModule(asIScriptModule* mod, const char* section_name, const std::string& source, const char* cache_file);
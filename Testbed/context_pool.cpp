@@ -0,0 +1,105 @@
+#include "context_pool.h"
+
+#include <assert.h>
+#include <vector>
+
+struct ContextPoolThreadCache
+{
+    std::vector<asIScriptContext*> contexts;
+    ContextPoolStats stats;
+
+    ~ContextPoolThreadCache()
+    {
+        // `ContextPoolClearThread()` must run while the engine is alive; here it may be gone already, so cached contexts are leaked.
+        assert(contexts.empty());
+    }
+};
+
+static ContextPoolThreadCache& GetThreadCache()
+{
+    thread_local ContextPoolThreadCache cache;
+    return cache;
+}
+
+static asIScriptContext* RequestContextCallback(asIScriptEngine* engine, void* /*param*/)
+{
+    ContextPoolThreadCache& cache = GetThreadCache();
+    cache.stats.acquired++;
+
+    // Search from the back - the most recently returned context is most likely still in CPU cache.
+    for (size_t i = cache.contexts.size(); i > 0; i--)
+    {
+        asIScriptContext* ctx = cache.contexts[i - 1];
+        if (ctx->GetEngine() == engine)
+        {
+            cache.contexts.erase(cache.contexts.begin() + (i - 1));
+            return ctx;
+        }
+    }
+
+    cache.stats.created++;
+    return engine->CreateContext();
+}
+
+static void ReturnContextCallback(asIScriptEngine* /*engine*/, asIScriptContext* ctx, void* /*param*/)
+{
+    // Drop references to arguments and return value, and the line callback (its param may point to a dead stack variable).
+    ctx->Unprepare();
+    ctx->ClearLineCallback();
+    GetThreadCache().contexts.push_back(ctx);
+}
+
+void ContextPoolInstall(asIScriptEngine* engine)
+{
+    int r = engine->SetContextCallbacks(RequestContextCallback, ReturnContextCallback, nullptr); assert(r >= 0);
+    (void)r;
+}
+
+asIScriptContext* ContextPoolAcquire(asIScriptEngine* engine, asIScriptFunction* func)
+{
+    // Nested call from a running script - reuse its context, like the AngelScript add-ons do.
+    asIScriptContext* ctx = asGetActiveContext();
+    if (ctx && ctx->GetEngine() == engine && ctx->PushState() >= 0)
+    {
+        ContextPoolThreadCache& cache = GetThreadCache();
+        cache.stats.acquired++;
+        cache.stats.nested++;
+    }
+    else
+    {
+        ctx = RequestContextCallback(engine, nullptr);
+        if (!ctx)
+            return nullptr;
+    }
+
+    if (ctx->Prepare(func) < 0)
+    {
+        ContextPoolRelease(ctx);
+        return nullptr;
+    }
+    return ctx;
+}
+
+void ContextPoolRelease(asIScriptContext* ctx)
+{
+    if (ctx->IsNested())
+        ctx->PopState(); // Also works if `Prepare()` failed, the pushed state is restored.
+    else
+        ReturnContextCallback(ctx->GetEngine(), ctx, nullptr);
+}
+
+void ContextPoolClearThread()
+{
+    ContextPoolThreadCache& cache = GetThreadCache();
+    for (asIScriptContext* ctx: cache.contexts)
+        ctx->Release();
+    cache.contexts.clear();
+}
+
+ContextPoolStats ContextPoolGetThreadStats()
+{
+    ContextPoolThreadCache& cache = GetThreadCache();
+    ContextPoolStats stats = cache.stats;
+    stats.cached = cache.contexts.size();
+    return stats;
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+// Reusable script contexts - creating a context and allocating its stack for every short callback is a real cost.
+// Contexts are cached per thread (a context may only execute on one thread at a time, and the cache needs no lock).
+// Returned contexts are `Unprepare()`d, so a cached context doesn't keep arguments or return values (i.e. our objects) alive.
+// When called from inside a script, `ContextPoolAcquire()` pushes a nested state on the active context instead
+// of taking another one; `ContextPoolRelease()` pops it again.
+
+#include <angelscript.h>
+#include <cstddef>
+
+struct ContextPoolStats
+{
+    size_t acquired = 0; //!< Total `ContextPoolAcquire()` + `engine->RequestContext()` calls.
+    size_t created = 0;  //!< Contexts created because the cache was empty.
+    size_t nested = 0;   //!< Acquires satisfied by pushing state on the active context.
+    size_t cached = 0;   //!< Contexts currently waiting in the cache.
+};
+
+/// Makes `engine->RequestContext()`/`ReturnContext()` (used by add-ons) go through the pool.
+void ContextPoolInstall(asIScriptEngine* engine);
+
+/// Returns a context prepared for `func`, or nullptr on error. Must be returned with `ContextPoolRelease()`.
+asIScriptContext* ContextPoolAcquire(asIScriptEngine* engine, asIScriptFunction* func);
+void ContextPoolRelease(asIScriptContext* ctx);
+
+/// Releases contexts cached by the calling thread - call before shutting down the engine and before a worker thread exits.
+void ContextPoolClearThread();
+ContextPoolStats ContextPoolGetThreadStats();
@@ -20,6 +20,8 @@
 #define COLOR_THEME_OBJ COLOR_LIGHT_MAGENTA
 #define COLOR_THEME_MAIN COLOR_LIGHT_GREEN
 
+#if defined(RCO_DEBUGTRACE_IOSTREAM) // Prints immediately, but slow and serializes all threads.
+
 #define RefCoutingObjectPtr_DEBUGTRACE(_arg_) {             \
     std::cout << __FUNCTION__ << " ref: (" << m_ref << ")"; \
     if (_arg_)                                              \
@@ -27,18 +29,23 @@
     std::cout << std::endl;                                 \
 }
 
-#define RefCoutingObjectPtr_DEBUGTRACE_STATIC(_self_, _arg_) {             \
-    std::cout << __FUNCTION__ << " ref: (" << (_self_)->m_ref << ")"; \
-    if (_arg_)                                              \
-        std::cout << ", arg: (" << _arg_ << ")";            \
-    std::cout << std::endl;                                 \
-}
-
 #define RefCoutingObject_DEBUGTRACE() {              \
     std::cout << __FUNCTION__ << " (" << this        \
-        << ") refcount:" << m_refcount << std::endl; \
+        << ") refcount:" << GetRefCount() << std::endl; \
 }
 
+#else // Binary ring buffer, see debug_trace.h
+
+#include "debug_trace.h"
+
+#define RefCoutingObjectPtr_DEBUGTRACE(_arg_) \
+    DEBUGTRACE_WRITE(DEBUGTRACE_KIND_PTR, this, m_ref, _arg_, 0)
+
+#define RefCoutingObject_DEBUGTRACE() \
+    DEBUGTRACE_WRITE(DEBUGTRACE_KIND_OBJECT, this, nullptr, nullptr, GetRefCount())
+
+#endif
+
 
 inline void PrintString(const std::string &str)
 {
@@ -0,0 +1,222 @@
+#include "debug_trace.h"
+
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// File layout: header, name table, tag table, records (sorted by timestamp).
+static const char DEBUGTRACE_MAGIC[4] = { 'R', 'C', 'O', 'T' };
+static const uint32_t DEBUGTRACE_VERSION = 1;
+
+struct DebugTraceRegistry
+{
+    std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<std::string> tags;
+    std::vector<DebugTraceRing*> rings;
+};
+
+static DebugTraceRegistry& GetRegistry()
+{
+    // Intentionally leaked - objects held by globals are traced after static destructors ran.
+    static DebugTraceRegistry* registry = new DebugTraceRegistry();
+    return *registry;
+}
+
+uint16_t DebugTraceInternName(const char* name)
+{
+    DebugTraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.names.push_back(name);
+    return (uint16_t)(registry.names.size() - 1);
+}
+
+DebugTraceRing* DebugTraceRegisterThread()
+{
+    DebugTraceRing* ring = new DebugTraceRing(); // Kept after thread exits, for the dump.
+    DebugTraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.rings.push_back(ring);
+    return ring;
+}
+
+void DebugTraceSetCallerTag(const char* tag)
+{
+    uint8_t tag_id = 0;
+    if (tag)
+    {
+        DebugTraceRegistry& registry = GetRegistry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto itor = std::find(registry.tags.begin(), registry.tags.end(), tag);
+        if (itor == registry.tags.end())
+            itor = registry.tags.insert(registry.tags.end(), tag);
+        tag_id = (uint8_t)(itor - registry.tags.begin() + 1);
+    }
+
+    DebugTraceGetThreadRing()->caller_tag = tag_id;
+}
+
+static void WriteString(FILE* f, const std::string& str)
+{
+    const uint32_t len = (uint32_t)str.size();
+    fwrite(&len, sizeof(len), 1, f);
+    fwrite(str.data(), 1, len, f);
+}
+
+/// Bytes left in the file - the upper bound for sizes read from it, so that a corrupt file can't request a huge allocation.
+static uint64_t RemainingBytes(FILE* f)
+{
+    const long pos = ftell(f);
+    if (pos < 0 || fseek(f, 0, SEEK_END) != 0)
+        return 0;
+    const long end = ftell(f);
+    if (fseek(f, pos, SEEK_SET) != 0)
+        return 0;
+    return (end > pos) ? (uint64_t)(end - pos) : 0;
+}
+
+static bool ReadString(FILE* f, std::string& str)
+{
+    uint32_t len = 0;
+    if (fread(&len, sizeof(len), 1, f) != 1 || len > RemainingBytes(f))
+        return false;
+    str.resize(len);
+    return len == 0 || fread(&str[0], 1, len, f) == len;
+}
+
+bool DebugTraceDump(const char* filename)
+{
+    DebugTraceRegistry& registry = GetRegistry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+
+    std::vector<DebugTraceRecord> records;
+    for (DebugTraceRing* ring: registry.rings)
+    {
+        const uint64_t head = ring->head.load(std::memory_order_acquire);
+        const uint64_t begin = (head > DEBUGTRACE_RING_CAPACITY) ? head - DEBUGTRACE_RING_CAPACITY : 0;
+        for (uint64_t i = begin; i < head; i++)
+            records.push_back(ring->records[i & (DEBUGTRACE_RING_CAPACITY - 1)]);
+    }
+    std::stable_sort(records.begin(), records.end(),
+        [](const DebugTraceRecord& a, const DebugTraceRecord& b) { return a.timestamp_ns < b.timestamp_ns; });
+
+    FILE* f = nullptr;
+    fopen_s(&f, filename, "wb");
+    if (!f)
+        return false;
+
+    fwrite(DEBUGTRACE_MAGIC, sizeof(DEBUGTRACE_MAGIC), 1, f);
+    fwrite(&DEBUGTRACE_VERSION, sizeof(DEBUGTRACE_VERSION), 1, f);
+    const uint32_t num_names = (uint32_t)registry.names.size();
+    fwrite(&num_names, sizeof(num_names), 1, f);
+    for (const std::string& name: registry.names)
+        WriteString(f, name);
+    const uint32_t num_tags = (uint32_t)registry.tags.size();
+    fwrite(&num_tags, sizeof(num_tags), 1, f);
+    for (const std::string& tag: registry.tags)
+        WriteString(f, tag);
+    const uint64_t num_records = records.size();
+    fwrite(&num_records, sizeof(num_records), 1, f);
+    if (num_records)
+        fwrite(records.data(), sizeof(DebugTraceRecord), records.size(), f);
+
+    return fclose(f) == 0;
+}
+
+struct DebugTraceLifetime
+{
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+    int peak_refcount = 0;
+    size_t num_ops = 0;
+    bool constructed = false;
+    bool destroyed = false;
+};
+
+bool DebugTraceDecode(const char* filename, FILE* out)
+{
+    FILE* f = nullptr;
+    fopen_s(&f, filename, "rb");
+    if (!f)
+        return false;
+
+    char magic[4] = {};
+    uint32_t version = 0;
+    std::vector<std::string> names;
+    std::vector<std::string> tags;
+    std::vector<DebugTraceRecord> records;
+    bool ok = fread(magic, sizeof(magic), 1, f) == 1
+        && std::equal(magic, magic + 4, DEBUGTRACE_MAGIC)
+        && fread(&version, sizeof(version), 1, f) == 1
+        && version == DEBUGTRACE_VERSION;
+
+    uint32_t count = 0;
+    ok = ok && fread(&count, sizeof(count), 1, f) == 1 && count <= RemainingBytes(f) / sizeof(uint32_t); // Each string has a length.
+    names.resize(ok ? count : 0);
+    for (std::string& name: names)
+        ok = ok && ReadString(f, name);
+    ok = ok && fread(&count, sizeof(count), 1, f) == 1 && count <= RemainingBytes(f) / sizeof(uint32_t);
+    tags.resize(ok ? count : 0);
+    for (std::string& tag: tags)
+        ok = ok && ReadString(f, tag);
+    uint64_t num_records = 0;
+    ok = ok && fread(&num_records, sizeof(num_records), 1, f) == 1 && num_records <= RemainingBytes(f) / sizeof(DebugTraceRecord);
+    records.resize(ok ? (size_t)num_records : 0);
+    ok = ok && (records.empty() || fread(records.data(), sizeof(DebugTraceRecord), records.size(), f) == records.size());
+    fclose(f);
+    if (!ok)
+        return false;
+
+    const uint64_t start_ns = records.empty() ? 0 : records.front().timestamp_ns;
+    std::map<uint64_t, std::vector<DebugTraceLifetime>> lifetimes; // Ordered by address, for stable output; one entry per object.
+
+    // The log, in the same format as the iostream macros, prefixed with time and caller tag.
+    for (const DebugTraceRecord& rec: records)
+    {
+        const char* op = (rec.op < names.size()) ? names[rec.op].c_str() : "?";
+        const char* tag = (rec.caller_tag > 0 && rec.caller_tag <= tags.size()) ? tags[rec.caller_tag - 1].c_str() : "";
+        fprintf(out, "[%10.3f us] %-8s ", (rec.timestamp_ns - start_ns) / 1000.0, tag);
+        if (rec.kind == DEBUGTRACE_KIND_OBJECT)
+        {
+            fprintf(out, "%s (0x%llx) refcount:%d\n", op, (unsigned long long)rec.self, rec.refcount);
+
+            std::vector<DebugTraceLifetime>& lives = lifetimes[rec.self];
+            if (lives.empty() || lives.back().destroyed) // Address reused by a new object - pooled allocators do it right away.
+                lives.push_back(DebugTraceLifetime{ rec.timestamp_ns });
+            DebugTraceLifetime& life = lives.back();
+            life.last_ns = rec.timestamp_ns;
+            life.peak_refcount = std::max(life.peak_refcount, rec.refcount);
+            life.num_ops++;
+            if (strchr(op, '~'))
+                life.destroyed = true;
+            else if (life.num_ops == 1 && rec.refcount == 0)
+                life.constructed = true;
+        }
+        else
+        {
+            fprintf(out, "%s ref: (0x%llx)", op, (unsigned long long)rec.ref);
+            if (rec.arg)
+                fprintf(out, ", arg: (0x%llx)", (unsigned long long)rec.arg);
+            fprintf(out, "\n");
+        }
+    }
+
+    // The timeline - one line per object, grouped by address (#1, #2 ... objects which lived there in turn).
+    fprintf(out, "\n--- object lifetimes ---\n");
+    for (auto& entry: lifetimes)
+    {
+        for (size_t i = 0; i < entry.second.size(); i++)
+        {
+            const DebugTraceLifetime& life = entry.second[i];
+            fprintf(out, "0x%llx #%zu: %10.3f us .. %10.3f us (%s .. %s), %zu ops, peak refcount %d\n",
+                (unsigned long long)entry.first, i + 1,
+                (life.first_ns - start_ns) / 1000.0, (life.last_ns - start_ns) / 1000.0,
+                life.constructed ? "constructed" : "before trace", life.destroyed ? "destroyed" : "alive",
+                life.num_ops, life.peak_refcount);
+        }
+    }
+    return true;
+}
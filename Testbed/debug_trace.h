@@ -0,0 +1,75 @@
+#pragma once
+
+// Binary trace of RefCountingObject(Ptr) operations, replacing the iostream DEBUGTRACE macros.
+// Each thread writes fixed-size records to its own lock-free ring buffer (oldest records are overwritten);
+// `DebugTraceDump()` saves all rings to a file, which `DebugTraceDecode()` turns into the human-readable log
+// and a per-object lifetime timeline (run `Testbed --decode-trace <file>`).
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+#define RCO_DEBUGTRACE_RING
+
+enum DebugTraceKind: uint8_t
+{
+    DEBUGTRACE_KIND_OBJECT = 0, //!< `RefCountingObject` - `refcount` is valid.
+    DEBUGTRACE_KIND_PTR    = 1, //!< `RefCountingObjectPtr` - `ref` and `arg` are valid.
+};
+
+struct DebugTraceRecord
+{
+    uint64_t timestamp_ns;  //!< Steady clock.
+    uint64_t self;          //!< `this` of the object or smart pointer.
+    uint64_t ref;           //!< Smart pointer: the held object.
+    uint64_t arg;           //!< Smart pointer: the argument (other object), if any.
+    int32_t  refcount;      //!< Object: refcount after the operation.
+    uint16_t op;            //!< Function name, see `DebugTraceInternName()`.
+    uint8_t  caller_tag;    //!< Set by `DebugTraceSetCallerTag()`, 0 = none.
+    DebugTraceKind kind;
+};
+static_assert(sizeof(DebugTraceRecord) == 40, "DebugTraceRecord must stay fixed-size");
+
+const size_t DEBUGTRACE_RING_CAPACITY = 1 << 16; // Records per thread; must be power of 2.
+
+/// Single producer (owning thread); read only by `DebugTraceDump()`.
+struct DebugTraceRing
+{
+    DebugTraceRecord records[DEBUGTRACE_RING_CAPACITY];
+    std::atomic<uint64_t> head{0}; //!< Total records ever written.
+    uint8_t caller_tag = 0;
+};
+
+uint16_t DebugTraceInternName(const char* name); // Thread-safe, to be called once per call site.
+DebugTraceRing* DebugTraceRegisterThread();
+void DebugTraceSetCallerTag(const char* tag); // Applies to the calling thread; nullptr clears it.
+bool DebugTraceDump(const char* filename);
+bool DebugTraceDecode(const char* filename, FILE* out);
+
+inline DebugTraceRing* DebugTraceGetThreadRing()
+{
+    thread_local DebugTraceRing* ring = DebugTraceRegisterThread();
+    return ring;
+}
+
+inline void DebugTraceWrite(DebugTraceKind kind, uint16_t op, const void* self, const void* ref, const void* arg, int32_t refcount)
+{
+    DebugTraceRing* ring = DebugTraceGetThreadRing();
+    const uint64_t head = ring->head.load(std::memory_order_relaxed);
+    DebugTraceRecord& rec = ring->records[head & (DEBUGTRACE_RING_CAPACITY - 1)];
+    rec.timestamp_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    rec.self = (uint64_t)(uintptr_t)self;
+    rec.ref = (uint64_t)(uintptr_t)ref;
+    rec.arg = (uint64_t)(uintptr_t)arg;
+    rec.refcount = refcount;
+    rec.op = op;
+    rec.caller_tag = ring->caller_tag;
+    rec.kind = kind;
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+#define DEBUGTRACE_WRITE(_kind_, _self_, _ref_, _arg_, _refcount_) {              \
+    static const uint16_t debugtrace_op = DebugTraceInternName(__FUNCTION__);      \
+    DebugTraceWrite(_kind_, debugtrace_op, _self_, _ref_, _arg_, _refcount_);      \
+}
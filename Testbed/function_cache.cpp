@@ -0,0 +1,57 @@
+#include "function_cache.h"
+
+#include <mutex>
+#include <unordered_map>
+
+struct FunctionCacheModuleData
+{
+    std::unordered_map<std::string, asIScriptFunction*> functions; //!< AddRef-ed; misses are not cached.
+};
+
+static std::mutex g_function_cache_mutex; // Only taken on lookup, `ScriptCallback` keeps the result.
+
+static void FunctionCacheCleanupCallback(asIScriptModule* mod)
+{
+    FunctionCacheModuleData* data = static_cast<FunctionCacheModuleData*>(mod->GetUserData(FUNCTION_CACHE_USERDATA));
+    if (!data)
+        return;
+    for (auto& entry: data->functions)
+        entry.second->Release();
+    delete data;
+}
+
+void FunctionCacheInstall(asIScriptEngine* engine)
+{
+    engine->SetModuleUserDataCleanupCallback(FunctionCacheCleanupCallback, FUNCTION_CACHE_USERDATA);
+}
+
+asIScriptFunction* FunctionCacheGet(asIScriptModule* mod, const char* decl)
+{
+    std::lock_guard<std::mutex> lock(g_function_cache_mutex);
+
+    FunctionCacheModuleData* data = static_cast<FunctionCacheModuleData*>(mod->GetUserData(FUNCTION_CACHE_USERDATA));
+    if (!data)
+    {
+        data = new FunctionCacheModuleData();
+        mod->SetUserData(data, FUNCTION_CACHE_USERDATA);
+    }
+
+    auto itor = data->functions.find(decl);
+    if (itor != data->functions.end())
+    {
+        // Valid unless the module was rebuilt in place since - then the old function has no module.
+        asIScriptFunction* func = itor->second;
+        if (func->GetModule() == mod)
+            return func;
+        func->Release();
+        data->functions.erase(itor);
+    }
+
+    asIScriptFunction* func = mod->GetFunctionByDecl(decl);
+    if (func)
+    {
+        func->AddRef();
+        data->functions.emplace(decl, func);
+    }
+    return func;
+}
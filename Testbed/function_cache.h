@@ -0,0 +1,234 @@
+#pragma once
+
+// Cache of script functions keyed by module and declaration, replacing `GetFunctionByDecl()` on the call path.
+// The per-module cache lives in the module's user data and is released by the module cleanup callback
+// when the module is discarded; when the module is rebuilt in place, stale entries are detected because
+// the old functions no longer report the module as their owner.
+// `ScriptCallback<TRet(TArgs...)>` is the typed invoker on top of it - arguments are bound with
+// `SetArg*()` by their C++ type, no strings are looked at per call.
+
+#include <angelscript.h>
+#include <assert.h>
+#include <string>
+#include <type_traits>
+
+#include "context_pool.h"
+#include "../RefCountingObjectPtr.h"
+
+const asPWORD FUNCTION_CACHE_USERDATA = 0x52434F46; // 'RCOF'
+
+/// Installs the module cleanup callback; must be called once per engine before `FunctionCacheGet()`.
+void FunctionCacheInstall(asIScriptEngine* engine);
+
+/// Returns the function (not AddRef-ed, owned by the cache) or nullptr if the module doesn't have it.
+asIScriptFunction* FunctionCacheGet(asIScriptModule* mod, const char* decl);
+
+// -------------------------------- Argument and return value binding -------------------------------
+
+template<typename T> struct ScriptArgIsPtr: std::false_type {};
+template<typename T> struct ScriptArgIsPtr<RefCountingObjectPtr<T>>: std::true_type {};
+
+/// How a C++ type is passed to/from the context; picks the `ScriptSetArgAs()`/`ScriptGetReturnAs()` overload.
+enum ScriptArgKind
+{
+    SCRIPT_ARG_PTR,     //!< `RefCountingObjectPtr<>`
+    SCRIPT_ARG_HANDLE,  //!< Raw object pointer
+    SCRIPT_ARG_REF,     //!< Any lvalue reference parameter
+    SCRIPT_ARG_FLOAT,
+    SCRIPT_ARG_DOUBLE,
+    SCRIPT_ARG_INTEGER, //!< Integers, bool and enums
+    SCRIPT_ARG_OBJECT,  //!< Other value types
+};
+
+template<ScriptArgKind K> using ScriptArgKindTag = std::integral_constant<ScriptArgKind, K>;
+
+/// `TParam` is the declared C++ parameter type; it decides between by-value and by-reference binding.
+template<typename TParam, typename T = std::remove_cv_t<std::remove_reference_t<TParam>>>
+using ScriptArgKindOf = ScriptArgKindTag<
+    ScriptArgIsPtr<T>::value ? SCRIPT_ARG_PTR :
+    std::is_pointer<T>::value ? SCRIPT_ARG_HANDLE :
+    std::is_lvalue_reference<TParam>::value ? SCRIPT_ARG_REF :
+    std::is_same<T, float>::value ? SCRIPT_ARG_FLOAT :
+    std::is_same<T, double>::value ? SCRIPT_ARG_DOUBLE :
+    (std::is_arithmetic<T>::value || std::is_enum<T>::value) ? SCRIPT_ARG_INTEGER :
+    SCRIPT_ARG_OBJECT>;
+
+template<typename T> int ScriptSetArgInteger(asIScriptContext* ctx, asUINT index, T arg, std::integral_constant<size_t, 1>) { return ctx->SetArgByte(index, (asBYTE)arg); }
+template<typename T> int ScriptSetArgInteger(asIScriptContext* ctx, asUINT index, T arg, std::integral_constant<size_t, 2>) { return ctx->SetArgWord(index, (asWORD)arg); }
+template<typename T> int ScriptSetArgInteger(asIScriptContext* ctx, asUINT index, T arg, std::integral_constant<size_t, 4>) { return ctx->SetArgDWord(index, (asDWORD)arg); }
+template<typename T> int ScriptSetArgInteger(asIScriptContext* ctx, asUINT index, T arg, std::integral_constant<size_t, 8>) { return ctx->SetArgQWord(index, (asQWORD)arg); }
+
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_PTR>)
+{
+    return ctx->SetArgObject(index, (void*)&arg); // Value type - the context makes its own copy, with AddRef.
+}
+
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_HANDLE>)
+{
+    return ctx->SetArgObject(index, (void*)arg); // Handle - the context AddRef-s it.
+}
+
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_REF>)
+{
+    return ctx->SetArgAddress(index, (void*)&arg); // &in/&out/&inout reference.
+}
+
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_FLOAT>) { return ctx->SetArgFloat(index, arg); }
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_DOUBLE>) { return ctx->SetArgDouble(index, arg); }
+
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_INTEGER>)
+{
+    return ScriptSetArgInteger(ctx, index, arg, std::integral_constant<size_t, sizeof(T)>());
+}
+
+template<typename T> int ScriptSetArgAs(asIScriptContext* ctx, asUINT index, T& arg, ScriptArgKindTag<SCRIPT_ARG_OBJECT>)
+{
+    return ctx->SetArgObject(index, (void*)&arg); // Other value types are copied by the context.
+}
+
+template<typename TParam>
+int ScriptSetArg(asIScriptContext* ctx, asUINT index, std::remove_reference_t<TParam>& arg)
+{
+    return ScriptSetArgAs(ctx, index, arg, ScriptArgKindOf<TParam>());
+}
+
+template<typename TRet> TRet ScriptGetReturnInteger(asIScriptContext* ctx, std::integral_constant<size_t, 1>) { return (TRet)ctx->GetReturnByte(); }
+template<typename TRet> TRet ScriptGetReturnInteger(asIScriptContext* ctx, std::integral_constant<size_t, 2>) { return (TRet)ctx->GetReturnWord(); }
+template<typename TRet> TRet ScriptGetReturnInteger(asIScriptContext* ctx, std::integral_constant<size_t, 4>) { return (TRet)ctx->GetReturnDWord(); }
+template<typename TRet> TRet ScriptGetReturnInteger(asIScriptContext* ctx, std::integral_constant<size_t, 8>) { return (TRet)ctx->GetReturnQWord(); }
+
+template<typename TRet, ScriptArgKind K> TRet ScriptGetReturnAs(asIScriptContext* /*ctx*/, ScriptArgKindTag<K>)
+{
+    static_assert(K != K, "Unsupported return type, use RefCountingObjectPtr for objects");
+    return TRet();
+}
+
+template<typename TRet> TRet ScriptGetReturnAs(asIScriptContext* ctx, ScriptArgKindTag<SCRIPT_ARG_PTR>)
+{
+    return *static_cast<TRet*>(ctx->GetReturnObject()); // Copy (AddRef) before the context is unprepared.
+}
+
+template<typename TRet> TRet ScriptGetReturnAs(asIScriptContext* ctx, ScriptArgKindTag<SCRIPT_ARG_FLOAT>) { return ctx->GetReturnFloat(); }
+template<typename TRet> TRet ScriptGetReturnAs(asIScriptContext* ctx, ScriptArgKindTag<SCRIPT_ARG_DOUBLE>) { return ctx->GetReturnDouble(); }
+
+template<typename TRet> TRet ScriptGetReturnAs(asIScriptContext* ctx, ScriptArgKindTag<SCRIPT_ARG_INTEGER>)
+{
+    return ScriptGetReturnInteger<TRet>(ctx, std::integral_constant<size_t, sizeof(TRet)>());
+}
+
+template<typename TRet>
+TRet ScriptGetReturn(asIScriptContext* ctx)
+{
+    return ScriptGetReturnAs<TRet>(ctx, ScriptArgKindOf<TRet>());
+}
+
+// -------------------------------- Typed invoker -------------------------------
+
+template<typename TSignature> class ScriptCallback;
+
+/// Resolves the function on first call and again only after the module was rebuilt or discarded.
+/// Not thread-safe - each thread should use its own instance (resolving through the cache is locked).
+template<typename TRet, typename... TArgs>
+class ScriptCallback<TRet(TArgs...)>
+{
+public:
+    ScriptCallback(asIScriptEngine* engine, const char* module_name, const char* decl)
+        : m_engine(engine), m_module_name(module_name ? module_name : ""), m_decl(decl)
+    {}
+
+    ~ScriptCallback()
+    {
+        if (m_func)
+            m_func->Release();
+    }
+
+    ScriptCallback(const ScriptCallback&) = delete;
+    ScriptCallback& operator=(const ScriptCallback&) = delete;
+
+    /// Returns the execution state (`asEXECUTION_FINISHED` on success) or negative error code -
+    /// `asNO_FUNCTION` if the function isn't there, or the error of an argument which couldn't be set.
+    int Call(TArgs... args)
+    {
+        asIScriptContext* ctx = nullptr;
+        const int prepared = this->PrepareArgs(ctx, args...);
+        if (prepared < 0)
+            return prepared;
+        const int r = ctx->Execute();
+        ContextPoolRelease(ctx);
+        return r;
+    }
+
+    /// Like `Call()`; `result` is only written if the function finished.
+    template<typename R = TRet, typename = std::enable_if_t<!std::is_void<R>::value>>
+    int Call(R& result, TArgs... args)
+    {
+        asIScriptContext* ctx = nullptr;
+        const int prepared = this->PrepareArgs(ctx, args...);
+        if (prepared < 0)
+            return prepared;
+        const int r = ctx->Execute();
+        if (r == asEXECUTION_FINISHED)
+            result = ScriptGetReturn<R>(ctx);
+        ContextPoolRelease(ctx);
+        return r;
+    }
+
+    /// For callers which need the context before it runs (i.e. to arm a watchdog): on success returns 0 and sets `ctx`,
+    /// which the caller executes and returns with `ContextPoolRelease()`. Otherwise returns negative error code, like `Call()`.
+    int Prepare(asIScriptContext*& ctx, TArgs... args)
+    {
+        return this->PrepareArgs(ctx, args...);
+    }
+
+    asIScriptFunction* GetFunction()
+    {
+        // A function from a rebuilt (or discarded) module no longer reports the module as its owner.
+        if (m_func && m_func->GetModule() != m_module)
+        {
+            m_func->Release();
+            m_func = nullptr;
+        }
+        if (!m_func)
+            this->Resolve();
+        return m_func;
+    }
+
+private:
+    void Resolve()
+    {
+        m_module = m_engine->GetModule(m_module_name.c_str(), asGM_ONLY_IF_EXISTS);
+        m_func = (m_module) ? FunctionCacheGet(m_module, m_decl.c_str()) : nullptr;
+        if (m_func)
+        {
+            assert(m_func->GetParamCount() == sizeof...(TArgs));
+            m_func->AddRef();
+        }
+    }
+
+    int PrepareArgs(asIScriptContext*& ctx, TArgs&... args)
+    {
+        asIScriptFunction* func = this->GetFunction();
+        if (!func)
+            return asNO_FUNCTION;
+        asIScriptContext* prepared = ContextPoolAcquire(m_engine, func);
+        if (!prepared)
+            return asERROR;
+        asUINT index = 0;
+        int r = 0;
+        int expand[] = { 0, (r = (r < 0) ? r : ScriptSetArg<TArgs>(prepared, index++, args), 0)... }; // Stops at the first error.
+        (void)expand; (void)index;
+        if (r < 0)
+        {
+            ContextPoolRelease(prepared);
+            return r;
+        }
+        ctx = prepared;
+        return 0;
+    }
+
+    asIScriptEngine* m_engine = nullptr;
+    std::string m_module_name;
+    std::string m_decl;
+    asIScriptModule* m_module = nullptr; //!< Only compared, may be dangling after discard.
+    asIScriptFunction* m_func = nullptr; //!< AddRef-ed.
+};
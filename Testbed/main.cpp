@@ -1,6 +1,9 @@
 #include <iostream>  // std::cout
 #include <assert.h>  // assert()
 #include <string.h>  // strstr()
+#include <stdlib.h>  // atoi()
+#include <chrono>    // std::chrono::steady_clock
+#include <memory>    // std::unique_ptr
 #ifdef __linux__
 	#include <sys/time.h>
 	#include <stdio.h>
@@ -12,6 +15,15 @@
 #endif
 #include <angelscript.h>
 #include "scriptstdstring.h"
+#include "context_pool.h"
+#include "function_cache.h"
+#include "watchdog.h"
+#include "mt_harness.h"
+#include "bytecode_cache.h"
+#include "bench.h"
+#if defined(RCO_ENABLE_STATS)
+	#include "../RefCountingObjectStats.h"
+#endif
 
 using namespace std;
 
@@ -55,20 +67,71 @@ int getch()
 int  RunApplication();
 void ConfigureEngine(asIScriptEngine *engine);
 int  CompileScript(asIScriptEngine *engine);
-void LineCallback(asIScriptContext *ctx, DWORD *timeOut);
+void PrintRefCountingObjectStats();
+void PrintWatchdogStats();
+void ScriptCheck(bool ok, const string &what);
 
 // Function prototypes implemented in "example.cpp"
 void ExampleCpp(asIScriptEngine *engine);
 
 int main(int argc, char **argv)
 {
-	RunApplication();
+#if defined(RCO_DEBUGTRACE_RING)
+	// Offline decoding of a trace saved by previous run
+	if( argc == 3 && strcmp(argv[1], "--decode-trace") == 0 )
+		return DebugTraceDecode(argv[2], stdout) ? 0 : 1;
+#endif
+
+	// Multi-threaded harness: --mt-harness [threads] [iterations] [script.as]
+	if( argc >= 2 && strcmp(argv[1], "--mt-harness") == 0 )
+	{
+		MtHarnessConfig config;
+		if( argc >= 3 )
+			config.max_threads = (unsigned)atoi(argv[2]);
+		if( argc >= 4 )
+			config.iterations = atoi(argv[3]);
+		if( argc >= 5 )
+			config.script_file = argv[4];
+		return RunMultiThreadedHarness(config) == 0 ? 0 : 1;
+	}
+
+	// Timing runs: --bench [iterations] [callbacks]
+	if( argc >= 2 && strcmp(argv[1], "--bench") == 0 )
+	{
+		BenchConfig config;
+		if( argc >= 3 )
+			config.iterations = atoi(argv[2]);
+		if( argc >= 4 )
+			config.callbacks = atoi(argv[3]);
+		return RunBenchmarks(config) == 0 ? 0 : 1;
+	}
+
+	const int r = RunApplication();
+
+#if defined(RCO_DEBUGTRACE_RING)
+	if( DebugTraceDump("rco_trace.bin") )
+		std::cout << "Trace saved to 'rco_trace.bin', decode with '--decode-trace rco_trace.bin'." << std::endl;
+#endif
 
 	// Wait until the user presses a key
 	std::cout << std::endl << "Press any key to quit." << std::endl;
 	while(!_getch());
 
-	return 0;
+	return ( r == 0 ) ? 0 : 1;
+}
+
+// Results of `Check()` calls from the script
+static int g_checksRun = 0;
+static int g_checksFailed = 0;
+
+void ScriptCheck(bool ok, const string &what)
+{
+	g_checksRun++;
+	if( !ok )
+	{
+		g_checksFailed++;
+		std::cout << COLOR_LIGHT_RED << "CHECK FAILED: " << what << COLOR_RESET << std::endl;
+	}
 }
 
 void MessageCallback(const asSMessageInfo *msg, void *param)
@@ -106,7 +169,14 @@ int RunApplication()
 	// and variables that the script should be able to use.
 	ConfigureEngine(engine);
 
+	// Contexts requested by the engine and add-ons are pooled too.
+	ContextPoolInstall(engine);
+	FunctionCacheInstall(engine);
+
 	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Executing Example.cpp ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+#if defined(RCO_DEBUGTRACE_RING)
+	DebugTraceSetCallerTag("C++");
+#endif
 	ExampleCpp(engine);
 	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ C++ finished ~~~~~~~~~~ " << COLOR_RESET << std::endl;
 	
@@ -118,67 +188,55 @@ int RunApplication()
 		return -1;
 	}
 
-	// Create a context that will execute the script.
-	asIScriptContext *ctx = engine->CreateContext();
-	if( ctx == 0 ) 
-	{
-		std::cout << "Failed to create the context." << std::endl;
-		engine->Release();
-		return -1;
-	}
-
-	// We don't want to allow the script to hang the application, e.g. with an
-	// infinite loop, so we'll use the line callback function to set a timeout
-	// that will abort the script after a certain time. Before executing the 
-	// script the timeOut variable will be set to the time when the script must 
-	// stop executing. 
-	DWORD timeOut;
-	r = ctx->SetLineCallback(asFUNCTION(LineCallback), &timeOut, asCALL_CDECL);
+	// Get a context prepared with the function we wish to execute. ScriptCallback<>
+	// finds the function through the cache - GetFunctionByDecl() is relatively slow,
+	// so the cache only calls it once per module build - and binds the arguments by
+	// their C++ types. The context comes from the pool, which reuses contexts (and
+	// their stacks) instead of creating one per call; that matters for hosts that
+	// run many short script callbacks.
+	// The callback holds a reference to the function, it must go before the engine.
+	std::unique_ptr<ScriptCallback<void()>> example(new ScriptCallback<void()>(engine, 0, "void ExampleAngelScript()"));
+	asIScriptContext *ctx = 0;
+	r = example->Prepare(ctx);
 	if( r < 0 )
 	{
-		std::cout << "Failed to set the line callback function." << std::endl;
-		ctx->Release();
-		engine->Release();
-		return -1;
-	}
-
-	// Find the function for the function we want to execute.
-	asIScriptFunction *func = engine->GetModule(0)->GetFunctionByDecl("void ExampleAngelScript()");
-	if( func == 0 )
-	{
-		std::cout << "The function 'void ExampleAngelScript()' was not found." << std::endl;
-		ctx->Release();
-		engine->Release();
-		return -1;
-	}
-
-	// Prepare the script context with the function we wish to execute. Prepare()
-	// must be called on the context before each new script function that will be
-	// executed. Note, that if you intend to execute the same function several 
-	// times, it might be a good idea to store the function returned by 
-	// GetFunctionByDecl(), so that this relatively slow call can be skipped.
-	r = ctx->Prepare(func);
-	if( r < 0 ) 
-	{
-		std::cout << "Failed to prepare the context." << std::endl;
-		ctx->Release();
+		if( r == asNO_FUNCTION )
+			std::cout << "The function 'void ExampleAngelScript()' was not found." << std::endl;
+		else
+			std::cout << "Failed to prepare the context (" << r << ")." << std::endl;
+		example.reset();
+		ContextPoolClearThread();
 		engine->Release();
 		return -1;
 	}
 
-	// Set the timeout before executing the function. Give the function 2 sec
-	// to return before we'll abort it.
-	timeOut = timeGetTime() + 2000;
+	// We don't want to allow the script to hang the application, e.g. with an
+	// infinite loop, so the watchdog will abort the script after a certain time.
+	// It runs its own timer thread, so unlike a line callback which checks the
+	// time, it doesn't slow down every executed line of the script.
+	// Give the function 2 sec to return before we'll abort it.
+	WatchdogStart();
+	WatchdogArm(ctx, 2000);
 
 	// Execute the function
 	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Executing Example.as ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+#if defined(RCO_DEBUGTRACE_RING)
+	DebugTraceSetCallerTag("script");
+#endif
 	r = ctx->Execute();
+#if defined(RCO_DEBUGTRACE_RING)
+	DebugTraceSetCallerTag(nullptr);
+#endif
+	const bool timedOut = WatchdogDisarm(ctx);
+	WatchdogStop();
 	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Script finished ~~~~~~~~~~ " << COLOR_RESET << std::endl;
 	if( r != asEXECUTION_FINISHED )
 	{
 		// The execution didn't finish as we had planned. Determine why.
-		if( r == asEXECUTION_ABORTED )
-			std::cout << "The script was aborted before it could finish. Probably it timed out." << std::endl;
+		if( r == asEXECUTION_ABORTED && timedOut )
+			std::cout << "The script was aborted before it could finish, it timed out." << std::endl;
+		else if( r == asEXECUTION_ABORTED )
+			std::cout << "The script was aborted before it could finish." << std::endl;
 		else if( r == asEXECUTION_EXCEPTION )
 		{
 			std::cout << "The script ended with an exception." << std::endl;
@@ -195,12 +253,23 @@ int RunApplication()
 			std::cout << "The script ended for some unforeseen reason (" << r << ")." << std::endl;
 	}
 
-	// We must release the contexts when no longer using them
-	ctx->Release();
+	// Return the context to the pool, and release the pooled contexts
+	// while the engine is still alive.
+	ContextPoolRelease(ctx);
+	example.reset();
+	ContextPoolClearThread();
 
 	// Shut down the engine
 	engine->ShutDownAndRelease();
 
+	PrintRefCountingObjectStats();
+	PrintWatchdogStats();
+
+	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Checks ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+	std::cout << g_checksRun << " checks, " << g_checksFailed << " failed." << std::endl;
+	if( r != asEXECUTION_FINISHED || g_checksFailed > 0 )
+		return -1;
+
 	return 0;
 }
 
@@ -222,6 +291,7 @@ void ConfigureEngine(asIScriptEngine *engine)
 	// to do the verification here as well.
 	r = engine->RegisterGlobalFunction("void Print(const string &in)", asFUNCTION(PrintString), asCALL_CDECL); assert( r >= 0 );
 	r = engine->RegisterGlobalFunction("uint GetSystemTime()", asFUNCTION(timeGetTime), asCALL_STDCALL); assert( r >= 0 );
+	r = engine->RegisterGlobalFunction("void Check(bool, const string &in)", asFUNCTION(ScriptCheck), asCALL_CDECL); assert( r >= 0 );
 	
 
 
@@ -238,8 +308,6 @@ void ConfigureEngine(asIScriptEngine *engine)
 
 int CompileScript(asIScriptEngine *engine)
 {
-	int r;
-
 	// We will load the script from a file on the disk.
 	FILE *f = nullptr;
 	fopen_s(&f, "../Example.as", "rb");
@@ -269,30 +337,28 @@ int CompileScript(asIScriptEngine *engine)
 		return -1;
 	}
 
-	// Add the script sections that will be compiled into executable code.
-	// If we want to combine more than one file into the same script, then 
-	// we can call AddScriptSection() several times for the same module and
-	// the script engine will treat them all as if they were one. The script
-	// section name, will allow us to localize any errors in the script code.
+	// Compile the script, or load the bytecode saved by a previous run. The
+	// cache is keyed by the script source and by everything registered to the
+	// engine, so the script is compiled again whenever either changes. The
+	// script section name, will allow us to localize any errors in the script
+	// code. If there are any compiler messages they will be written to the
+	// message stream that we set right after creating the script engine.
 	asIScriptModule *mod = engine->GetModule(0, asGM_ALWAYS_CREATE);
-	r = mod->AddScriptSection("script", &script[0], len);
-	if( r < 0 ) 
-	{
-		std::cout << "AddScriptSection() failed" << std::endl;
-		return -1;
-	}
-	
-	// Compile the script. If there are any compiler messages they will
-	// be written to the message stream that we set right after creating the 
-	// script engine. If there are no errors, and no warnings, nothing will
-	// be written to the stream.
-	r = mod->Build();
-	if( r < 0 )
+	const auto start = std::chrono::steady_clock::now();
+	BytecodeCacheResult result = BytecodeCacheBuildModule(mod, "script", script, "Example.asbc");
+	const std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+	if( result == BYTECODE_CACHE_FAILED )
 	{
 		std::cout << "Build() failed" << std::endl;
 		return -1;
 	}
 
+	// Run twice to compare a cold start with a warm one.
+	if( result == BYTECODE_CACHE_LOADED )
+		std::cout << "Warm start: bytecode loaded from cache in " << elapsed.count() << " ms." << std::endl;
+	else
+		std::cout << "Cold start: script compiled (and cached) in " << elapsed.count() << " ms." << std::endl;
+
 	// The engine doesn't keep a copy of the script sections after Build() has
 	// returned. So if the script needs to be recompiled, then all the script
 	// sections must be added again.
@@ -306,17 +372,27 @@ int CompileScript(asIScriptEngine *engine)
 	return 0;
 }
 
-void LineCallback(asIScriptContext *ctx, DWORD *timeOut)
+void PrintRefCountingObjectStats()
 {
-	// If the time out is reached we abort the script
-	if( *timeOut < timeGetTime() )
-		ctx->Abort();
-
-	// It would also be possible to only suspend the script,
-	// instead of aborting it. That would allow the application
-	// to resume the execution where it left of at a later 
-	// time, by simply calling Execute() again.
+#if defined(RCO_ENABLE_STATS)
+	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ RefCountingObject stats ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+	for (const RefCountingObjectStatsSnapshot& snap: RefCountingObjectStats::TakeSnapshot())
+	{
+		std::cout << snap.type_name
+			<< ": live " << snap.live << " (peak " << snap.peak_live << ")"
+			<< ", constructed " << snap.constructed
+			<< ", destroyed from C++ " << snap.destroyed_from_cpp << " / from script " << snap.destroyed_from_script
+			<< ", AddRef " << snap.addref_calls << ", Release " << snap.release_calls << std::endl;
+	}
+#endif
 }
 
-
-
+void PrintWatchdogStats()
+{
+	const WatchdogStats stats = WatchdogGetStats();
+	std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Watchdog stats ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+	std::cout << "armed " << stats.armed << ", fired " << stats.fired
+		<< ", timer wakeups " << stats.timer_wakeups
+		<< ", line callbacks " << stats.line_callbacks << ", clock reads " << stats.clock_reads
+		<< " (~" << stats.lost_ns / 1000 << " us of script time)" << std::endl;
+}
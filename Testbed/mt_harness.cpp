@@ -0,0 +1,316 @@
+#include "mt_harness.h"
+
+// Measure the scaling, not the tracing which "debug_log.h" turns on for the rest of the Testbed -
+// the ring trace adds a write per refcount operation and a trace ring per worker thread.
+// Only the `Mt*` types are instantiated in this file, so no other type sees the difference.
+#undef RefCoutingObject_DEBUGTRACE
+#define RefCoutingObject_DEBUGTRACE()
+#undef RefCoutingObjectPtr_DEBUGTRACE
+#define RefCoutingObjectPtr_DEBUGTRACE(_arg_)
+
+#include "context_pool.h"
+#include "function_cache.h"
+#include "watchdog.h"
+#include "scriptstdstring.h"
+#include "../RefCountingObject.h"
+#include "../RefCountingObjectPtr.h"
+#include "../RefCountingObjectRegistration.h"
+#include "../AtomicRefCountingObjectPtr.h"
+#include "../RefCountingObjectBiased.h"
+
+#include <angelscript.h>
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Implemented in "main.cpp"
+void MessageCallback(const asSMessageInfo *msg, void *param);
+
+// Each iteration swaps a new horse for whatever horse another worker left in the stable,
+// reads the shared parrot and now and then replaces it.
+static const char* MT_HARNESS_SCRIPT = R"(
+void Work(int iterations)
+{
+    for (int i = 0; i < iterations; i++)
+    {
+        HorsePtr@ mine = Horse();
+        HorsePtr@ theirs = stable.Exchange(mine);
+        @mine = theirs;
+        Parrot@ parrot = aviary;
+        if (i % 64 == 0)
+            @aviary = Parrot();
+    }
+}
+)";
+
+static std::atomic<int> g_mt_live_objects{0};
+static std::atomic<int> g_mt_biased_live_objects{0};
+
+// Own types with a thread-safe policy; the script names are the same as in Example.cpp.
+class MtHorse;
+class MtParrot;
+
+template<> struct RefCountingObjectTraits<MtHorse>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool acyclic = true; // Holds no references - keeps the GC out of the measurement.
+    static constexpr char name[] = "Horse";
+    static constexpr char ptr_name[] = "HorsePtr";
+};
+constexpr char RefCountingObjectTraits<MtHorse>::name[];
+constexpr char RefCountingObjectTraits<MtHorse>::ptr_name[];
+
+template<> struct RefCountingObjectTraits<MtParrot>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool acyclic = true;
+    static constexpr char name[] = "Parrot";
+    static constexpr char ptr_name[] = "ParrotPtr";
+};
+constexpr char RefCountingObjectTraits<MtParrot>::name[];
+constexpr char RefCountingObjectTraits<MtParrot>::ptr_name[];
+
+class MtHorse: public RefCountingObject<MtHorse, RCO_MT_HARNESS_POLICY>
+{
+public:
+    MtHorse() { g_mt_live_objects++; }
+    ~MtHorse() { g_mt_live_objects--; }
+};
+
+class MtParrot: public RefCountingObject<MtParrot, RCO_MT_HARNESS_POLICY>
+{
+public:
+    MtParrot() { g_mt_live_objects++; }
+    ~MtParrot() { g_mt_live_objects--; }
+};
+
+// Biased counting stress - not registered to script, see `MtHarnessBiasedStress()`.
+class MtBiased;
+template<> struct RefCountingObjectTraits<MtBiased>: RefCountingObjectDefaultTraits
+{
+    static constexpr bool virtual_destructor = false;
+};
+
+class MtBiased final: public RefCountingObject<MtBiased, RefCountingObjectBiased>
+{
+public:
+    MtBiased() { g_mt_biased_live_objects++; }
+    ~MtBiased() { g_mt_biased_live_objects--; }
+};
+
+static AtomicRefCountingObjectPtr<MtHorse> g_mt_stable;
+static AtomicRefCountingObjectPtr<MtParrot> g_mt_aviary;
+
+static MtHorse* MtHorseFactory() { return MtHorse::Create(); } // Registered as "Horse@+ f()"
+static MtParrot* MtParrotFactory() { return MtParrot::Create(); } // Registered as "Parrot@+ f()"
+
+static void MtHarnessConfigureEngine(asIScriptEngine* engine)
+{
+    int r;
+    engine->SetMessageCallback(asFUNCTION(MessageCallback), 0, asCALL_CDECL);
+    RegisterStdString(engine);
+    r = engine->RegisterGlobalFunction("void Print(const string &in)", asFUNCTION(PrintString), asCALL_CDECL); assert( r >= 0 );
+
+    RegisterRefCountingObjectTypes<MtHorse, MtParrot>(engine);
+    r = engine->RegisterObjectBehaviour("Horse", asBEHAVE_FACTORY, "Horse@+ f()", asFUNCTION(MtHorseFactory), asCALL_CDECL); assert( r >= 0 );
+    r = engine->RegisterObjectBehaviour("Parrot", asBEHAVE_FACTORY, "Parrot@+ f()", asFUNCTION(MtParrotFactory), asCALL_CDECL); assert( r >= 0 );
+
+    // Shared between workers
+    AtomicRefCountingObjectPtr<MtHorse>::RegisterAtomicRefCountingObjectPtr(engine, "AtomicHorsePtr", "Horse");
+    AtomicRefCountingObjectPtr<MtParrot>::RegisterAtomicRefCountingObjectPtr(engine, "AtomicParrotPtr", "Parrot");
+    r = engine->RegisterGlobalProperty("AtomicHorsePtr stable", &g_mt_stable); assert( r >= 0 );
+    r = engine->RegisterGlobalProperty("AtomicParrotPtr aviary", &g_mt_aviary); assert( r >= 0 );
+
+    ContextPoolInstall(engine);
+    FunctionCacheInstall(engine);
+    (void)r;
+}
+
+static bool MtHarnessLoadScript(const MtHarnessConfig& config, std::string& script)
+{
+    if (!config.script_file)
+    {
+        script = MT_HARNESS_SCRIPT;
+        return true;
+    }
+
+    std::ifstream file(config.script_file, std::ios::binary);
+    if (!file)
+        return false;
+    std::stringstream buf;
+    buf << file.rdbuf();
+    script = buf.str();
+    return true;
+}
+
+static void MtHarnessWorker(asIScriptEngine* engine, const MtHarnessConfig* config,
+    const std::atomic<bool>* go, std::atomic<int>* failures)
+{
+    {
+        // Each worker has its own callback (they aren't thread-safe), resolved before the clock starts.
+        ScriptCallback<void(int)> work(engine, "mt_harness", "void Work(int)");
+        work.GetFunction();
+
+        while (!go->load(std::memory_order_acquire))
+            std::this_thread::yield();
+
+        asIScriptContext* ctx = nullptr;
+        int r = work.Prepare(ctx, config->iterations);
+        if (r >= 0)
+        {
+            WatchdogArm(ctx, config->budget_ms);
+            r = ctx->Execute();
+            WatchdogDisarm(ctx);
+            ContextPoolRelease(ctx);
+        }
+        if (r != asEXECUTION_FINISHED)
+            (*failures)++;
+    }
+
+    // The engine outlives this thread - release its per-thread resources now.
+    ContextPoolClearThread();
+    asThreadCleanup();
+}
+
+// The owner thread (this one) merges its counter while two other threads release and add references:
+// each object starts with 3 owner-counted references - one kept, one for worker A which releases it
+// (the shared counter goes negative, the object is queued), one for worker B which adds a reference
+// of its own and hands both back. The owner then releases all 3, the last release merges the counters.
+// Returns the number of objects left alive after `ProcessQueue()`.
+static int MtHarnessBiasedStress(const MtHarnessConfig& config)
+{
+    const int BATCH = 1000;
+    std::vector<MtBiased*> objs(BATCH);
+    std::unique_ptr<std::atomic<bool>[]> handed_back(new std::atomic<bool>[BATCH]);
+
+    for (int done = 0; done < config.iterations; done += BATCH)
+    {
+        for (int i = 0; i < BATCH; i++)
+        {
+            objs[i] = MtBiased::Create();
+            objs[i]->AddRef(); // Owner's reference.
+            objs[i]->AddRef(); // For worker A.
+            objs[i]->AddRef(); // For worker B.
+            handed_back[i].store(false, std::memory_order_relaxed);
+        }
+
+        std::atomic<bool> go{false};
+        std::thread worker_a([&objs, &go]()
+        {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (int i = 0; i < BATCH; i++)
+                objs[i]->Release();
+        });
+        std::thread worker_b([&objs, &handed_back, &go]()
+        {
+            while (!go.load(std::memory_order_acquire))
+                std::this_thread::yield();
+            for (int i = 0; i < BATCH; i++)
+            {
+                objs[i]->AddRef();
+                handed_back[i].store(true, std::memory_order_release); // Both references now belong to the owner.
+            }
+        });
+
+        go.store(true, std::memory_order_release);
+        for (int i = 0; i < BATCH; i++)
+        {
+            while (!handed_back[i].load(std::memory_order_acquire))
+                std::this_thread::yield();
+            objs[i]->Release(3);
+        }
+        worker_a.join();
+        worker_b.join();
+        RefCountingObjectBiased::ProcessQueue();
+    }
+
+    return g_mt_biased_live_objects.load();
+}
+
+int RunMultiThreadedHarness(const MtHarnessConfig& config)
+{
+    std::string script;
+    if (!MtHarnessLoadScript(config, script))
+    {
+        std::cout << "Failed to open the script file '" << config.script_file << "'." << std::endl;
+        return -1;
+    }
+
+    // Engine is created here and used by the workers.
+    asPrepareMultithread();
+    asIScriptEngine* engine = asCreateScriptEngine();
+    MtHarnessConfigureEngine(engine);
+
+    asIScriptModule* mod = engine->GetModule("mt_harness", asGM_ALWAYS_CREATE);
+    int r = mod->AddScriptSection((config.script_file) ? config.script_file : "mt_harness", script.c_str(), script.size());
+    if (r >= 0)
+        r = mod->Build();
+    asIScriptFunction* func = (r >= 0) ? FunctionCacheGet(mod, "void Work(int)") : nullptr;
+    if (!func)
+    {
+        std::cout << "Failed to build the script, or 'void Work(int)' was not found." << std::endl;
+        engine->ShutDownAndRelease();
+        asUnprepareMultithread();
+        return -1;
+    }
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Multi-threaded harness ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+#if defined(RCO_MT_HARNESS_TSAN)
+    std::cout << "ThreadSanitizer detected - reduced workload." << std::endl;
+#endif
+    WatchdogStart();
+
+    std::atomic<int> failures{0};
+    double base_rate = 0.0;
+    const unsigned max_threads = (config.max_threads > 0) ? config.max_threads : 1;
+    for (unsigned num_threads = 1; ; num_threads = (num_threads * 2 < max_threads) ? num_threads * 2 : max_threads)
+    {
+        std::atomic<bool> go{false};
+        std::vector<std::thread> workers;
+        for (unsigned i = 0; i < num_threads; i++)
+            workers.emplace_back(MtHarnessWorker, engine, &config, &go, &failures);
+
+        const auto start = std::chrono::steady_clock::now();
+        go.store(true, std::memory_order_release);
+        for (std::thread& worker: workers)
+            worker.join();
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        const double rate = (double)num_threads * config.iterations / elapsed.count();
+        if (num_threads == 1)
+            base_rate = rate;
+        std::cout << num_threads << " thread(s): " << (uint64_t)rate << " iterations/s, "
+            << "scaling " << rate / base_rate << "x" << std::endl;
+
+        if (num_threads == max_threads)
+            break;
+    }
+
+    WatchdogStop();
+
+    std::cout << COLOR_THEME_MAIN << " ~~~~~~~~~~ Biased refcount stress ~~~~~~~~~~ " << COLOR_RESET << std::endl;
+    const int biased_leaked = MtHarnessBiasedStress(config);
+    std::cout << config.iterations << " objects merged by the owner while other threads released them, "
+        << biased_leaked << " left alive." << std::endl;
+
+    // Empty the shared globals, then everything the scripts created must be gone.
+    g_mt_stable.store(nullptr);
+    g_mt_aviary.store(nullptr);
+    ContextPoolClearThread();
+    engine->ShutDownAndRelease();
+    asUnprepareMultithread();
+
+    const int leaked = g_mt_live_objects.load();
+    if (failures > 0)
+        std::cout << "FAILED: " << failures << " worker(s) didn't finish the script." << std::endl;
+    if (leaked != 0)
+        std::cout << "FAILED: " << leaked << " object(s) leaked or destroyed twice." << std::endl;
+    if (biased_leaked != 0)
+        std::cout << "FAILED: " << biased_leaked << " biased object(s) never destroyed." << std::endl;
+    return (failures == 0 && leaked == 0 && biased_leaked == 0) ? 0 : -1;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+// Multi-threaded harness - N workers, each with its own context, run a script on one shared engine.
+// The scripts pass `HorsePtr`/`ParrotPtr` objects to each other through registered globals
+// (`AtomicRefCountingObjectPtr`); the harness reports throughput for 1, 2, 4 ... N threads and checks
+// that all objects were destroyed. Then it stresses `RefCountingObjectBiased` in C++: the owner thread merges
+// its counters while other threads release the same objects.
+// Run as `Testbed --mt-harness [threads] [iterations] [script.as]`.
+//
+// ThreadSanitizer: build the Testbed AND AngelScript with `-fsanitize=thread` (AngelScript's own atomics
+// are invisible to TSan otherwise). The harness detects it and shrinks the workload to keep TSan runs short.
+// To see TSan flag an unsafe refcount path, build with e.g. `-DRCO_MT_HARNESS_POLICY=RefCountingObjectSingleThreaded`.
+
+#include <thread>
+
+#if defined(__SANITIZE_THREAD__)
+    #define RCO_MT_HARNESS_TSAN
+#elif defined(__has_feature)
+    #if __has_feature(thread_sanitizer)
+        #define RCO_MT_HARNESS_TSAN
+    #endif
+#endif
+
+#if !defined(RCO_MT_HARNESS_POLICY)
+    #define RCO_MT_HARNESS_POLICY RefCountingObjectMultiThreaded
+#endif
+
+struct MtHarnessConfig
+{
+#if defined(RCO_MT_HARNESS_TSAN)
+    unsigned max_threads = 4;
+    int iterations = 1000;      //!< Per worker and round.
+#else
+    unsigned max_threads = std::thread::hardware_concurrency();
+    int iterations = 100000;    //!< Per worker and round.
+#endif
+    const char* script_file = nullptr; //!< Must define `void Work(int iterations)`; nullptr = built-in script.
+    unsigned budget_ms = 60000; //!< Watchdog budget of each worker.
+};
+
+/// Returns 0 on success, -1 if the script failed or objects leaked.
+int RunMultiThreadedHarness(const MtHarnessConfig& config);
@@ -0,0 +1,219 @@
+#include "watchdog.h"
+
+#include <assert.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+    #include <time.h>
+#else
+    #include <windows.h> // GetTickCount64()
+#endif
+
+struct WatchdogEntry
+{
+    asIScriptContext* ctx = nullptr;
+    uint64_t deadline_ms = 0; //!< `WatchdogCoarseNowMs()` time.
+    WatchdogAction action = WATCHDOG_ACTION_ABORT;
+    bool fired = false;        //!< Thread mode: guarded by mutex; line mode: owned by the script thread.
+    unsigned lines = 0;        //!< Line mode: lines since last clock read.
+    uint64_t line_callbacks = 0;
+    uint64_t clock_reads = 0;
+};
+
+struct Watchdog
+{
+    WatchdogMode mode = WATCHDOG_MODE_THREAD;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<WatchdogEntry*> entries;
+    std::vector<WatchdogEntry*> free_entries; //!< Recycled by `WatchdogDisarm()`, so arming doesn't allocate.
+    std::thread thread;
+    bool running = false;
+    uint64_t next_deadline_ms = UINT64_MAX; //!< What the thread waits for; arming only wakes it for an earlier deadline.
+    uint64_t clock_read_ns = 0; //!< Calibrated cost of `WatchdogCoarseNowMs()`.
+
+    std::atomic<uint64_t> armed{0};
+    std::atomic<uint64_t> fired{0};
+    std::atomic<uint64_t> timer_wakeups{0};
+    std::atomic<uint64_t> line_callbacks{0};
+    std::atomic<uint64_t> clock_reads{0};
+};
+
+static Watchdog g_watchdog;
+
+// Resolution of a few ms (one tick) is plenty for budgets and it's read from vDSO data, not a syscall.
+static uint64_t WatchdogCoarseNowMs()
+{
+#ifdef __linux__
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+#else
+    return GetTickCount64();
+#endif
+}
+
+static void WatchdogFire(WatchdogEntry* entry)
+{
+    entry->fired = true;
+    g_watchdog.fired++;
+    if (entry->action == WATCHDOG_ACTION_SUSPEND)
+        entry->ctx->Suspend();
+    else
+        entry->ctx->Abort();
+}
+
+static void WatchdogThreadMain()
+{
+    std::unique_lock<std::mutex> lock(g_watchdog.mutex);
+    while (g_watchdog.running)
+    {
+        const uint64_t now = WatchdogCoarseNowMs();
+        uint64_t next = UINT64_MAX;
+        for (WatchdogEntry* entry: g_watchdog.entries)
+        {
+            if (entry->fired)
+                continue;
+            if (entry->deadline_ms <= now)
+                WatchdogFire(entry); // Under the mutex - the context can't be disarmed and reused meanwhile.
+            else if (entry->deadline_ms < next)
+                next = entry->deadline_ms;
+        }
+
+        g_watchdog.next_deadline_ms = next;
+        if (next == UINT64_MAX)
+            g_watchdog.cv.wait(lock);
+        else
+            g_watchdog.cv.wait_for(lock, std::chrono::milliseconds(next - now));
+        g_watchdog.timer_wakeups++;
+    }
+}
+
+static void WatchdogLineCallback(asIScriptContext* ctx, WatchdogEntry* entry)
+{
+    entry->line_callbacks++;
+    if (++entry->lines < WATCHDOG_LINE_CHECK_INTERVAL)
+        return;
+    entry->lines = 0;
+    entry->clock_reads++;
+    if (!entry->fired && WatchdogCoarseNowMs() >= entry->deadline_ms)
+        WatchdogFire(entry);
+    (void)ctx;
+}
+
+void WatchdogStart(WatchdogMode mode)
+{
+    assert(!g_watchdog.running);
+    g_watchdog.mode = mode;
+
+    // Calibrate the clock read, for `WatchdogStats::lost_ns`.
+    const int CALIBRATION_READS = 10000;
+    volatile uint64_t sink = 0;
+    const auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < CALIBRATION_READS; i++)
+        sink = sink + WatchdogCoarseNowMs();
+    const auto elapsed = std::chrono::steady_clock::now() - start;
+    g_watchdog.clock_read_ns = (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count() / CALIBRATION_READS;
+
+    if (mode == WATCHDOG_MODE_THREAD)
+    {
+        g_watchdog.running = true;
+        g_watchdog.thread = std::thread(WatchdogThreadMain);
+    }
+}
+
+void WatchdogStop()
+{
+    {
+        std::lock_guard<std::mutex> lock(g_watchdog.mutex);
+        assert(g_watchdog.entries.empty());
+        for (WatchdogEntry* entry: g_watchdog.free_entries)
+            delete entry;
+        g_watchdog.free_entries.clear();
+        if (!g_watchdog.running)
+            return;
+        g_watchdog.running = false;
+    }
+    g_watchdog.cv.notify_one();
+    g_watchdog.thread.join();
+    g_watchdog.next_deadline_ms = UINT64_MAX;
+}
+
+void WatchdogArm(asIScriptContext* ctx, unsigned budget_ms, WatchdogAction action)
+{
+    const uint64_t deadline_ms = WatchdogCoarseNowMs() + budget_ms;
+    WatchdogEntry* entry = nullptr;
+    bool wake = false;
+    {
+        std::lock_guard<std::mutex> lock(g_watchdog.mutex);
+        if (g_watchdog.free_entries.empty())
+        {
+            entry = new WatchdogEntry();
+        }
+        else
+        {
+            entry = g_watchdog.free_entries.back();
+            g_watchdog.free_entries.pop_back();
+        }
+        entry->ctx = ctx;
+        entry->deadline_ms = deadline_ms;
+        entry->action = action;
+        g_watchdog.entries.push_back(entry);
+
+        // Usually a later deadline than the one the thread already waits for - it will pick this one up then.
+        if (g_watchdog.mode == WATCHDOG_MODE_THREAD && deadline_ms < g_watchdog.next_deadline_ms)
+        {
+            g_watchdog.next_deadline_ms = deadline_ms;
+            wake = true;
+        }
+    }
+    g_watchdog.armed++;
+    if (wake)
+        g_watchdog.cv.notify_one();
+
+    if (g_watchdog.mode == WATCHDOG_MODE_LINE_CALLBACK)
+    {
+        int r = ctx->SetLineCallback(asFUNCTION(WatchdogLineCallback), entry, asCALL_CDECL); assert(r >= 0);
+        (void)r;
+    }
+}
+
+bool WatchdogDisarm(asIScriptContext* ctx)
+{
+    if (g_watchdog.mode == WATCHDOG_MODE_LINE_CALLBACK)
+        ctx->ClearLineCallback();
+
+    std::lock_guard<std::mutex> lock(g_watchdog.mutex);
+    std::vector<WatchdogEntry*>& entries = g_watchdog.entries;
+    size_t i = 0;
+    while (i < entries.size() && entries[i]->ctx != ctx)
+        i++;
+    if (i == entries.size())
+        return false;
+    WatchdogEntry* entry = entries[i];
+    entries[i] = entries.back(); // Order doesn't matter.
+    entries.pop_back();
+
+    g_watchdog.line_callbacks += entry->line_callbacks;
+    g_watchdog.clock_reads += entry->clock_reads;
+    const bool fired = entry->fired;
+    *entry = WatchdogEntry();
+    g_watchdog.free_entries.push_back(entry);
+    return fired;
+}
+
+WatchdogStats WatchdogGetStats()
+{
+    WatchdogStats stats;
+    stats.armed = g_watchdog.armed;
+    stats.fired = g_watchdog.fired;
+    stats.timer_wakeups = g_watchdog.timer_wakeups;
+    stats.line_callbacks = g_watchdog.line_callbacks;
+    stats.clock_reads = g_watchdog.clock_reads;
+    stats.lost_ns = stats.clock_reads * g_watchdog.clock_read_ns;
+    return stats;
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+// Script watchdog - aborts (or suspends) scripts which exceed their time budget.
+// `WATCHDOG_MODE_THREAD` (default): one timer thread tracks deadlines of all armed contexts and calls
+//   `Abort()`/`Suspend()` itself; scripts run without a line callback, so the watchdog costs them nothing.
+// `WATCHDOG_MODE_LINE_CALLBACK`: for hosts which can't spare a thread - a line callback reads a coarse
+//   monotonic clock every `WATCHDOG_LINE_CHECK_INTERVAL` lines instead of the wall clock on every line.
+
+#include <angelscript.h>
+#include <cstdint>
+
+enum WatchdogMode
+{
+    WATCHDOG_MODE_THREAD,
+    WATCHDOG_MODE_LINE_CALLBACK,
+};
+
+enum WatchdogAction
+{
+    WATCHDOG_ACTION_ABORT,   //!< `Execute()` returns `asEXECUTION_ABORTED`.
+    WATCHDOG_ACTION_SUSPEND, //!< `Execute()` returns `asEXECUTION_SUSPENDED`; re-arm and `Execute()` again to resume.
+};
+
+const unsigned WATCHDOG_LINE_CHECK_INTERVAL = 1000;
+
+struct WatchdogStats
+{
+    uint64_t armed = 0;
+    uint64_t fired = 0;
+    uint64_t timer_wakeups = 0;  //!< Thread mode.
+    uint64_t line_callbacks = 0; //!< Line callback mode; counted per disarmed context.
+    uint64_t clock_reads = 0;    //!< Line callback mode.
+    uint64_t lost_ns = 0;        //!< Estimated script time spent reading the clock (calibrated at start; VM's callback dispatch not included).
+};
+
+void WatchdogStart(WatchdogMode mode = WATCHDOG_MODE_THREAD);
+void WatchdogStop(); // All contexts must be disarmed.
+
+/// Call right before `ctx->Execute()`. Contexts are thread-safe to arm from any thread; one arm per context at a time.
+void WatchdogArm(asIScriptContext* ctx, unsigned budget_ms, WatchdogAction action = WATCHDOG_ACTION_ABORT);
+/// Call right after `ctx->Execute()` returns; returns true if the budget ran out.
+bool WatchdogDisarm(asIScriptContext* ctx);
+
+WatchdogStats WatchdogGetStats();